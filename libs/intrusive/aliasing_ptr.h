@@ -0,0 +1,239 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_ALIASING_PTR_H
+#define _INTRUSIVE_ALIASING_PTR_H
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/relocate.h"
+
+namespace wstux {
+namespace details {
+
+/* Reference counting hooks of the owner, whose type is erased. */
+struct alias_owner_ops
+{
+    void (*add_ref)(const void* p_owner);
+    void (*release)(const void* p_owner);
+};
+
+template<typename TOwner>
+struct alias_owner_ops_of
+{
+    static void add_ref(const void* p_owner) { intrusive_ptr_add_ref(cast(p_owner)); }
+
+    static void release(const void* p_owner) { intrusive_ptr_release(cast(p_owner)); }
+
+    static TOwner* cast(const void* p_owner)
+    {
+        return const_cast<TOwner*>(static_cast<const TOwner*>(p_owner));
+    }
+
+    static const alias_owner_ops ops;
+};
+
+template<typename TOwner>
+const alias_owner_ops alias_owner_ops_of<TOwner>::ops = {&alias_owner_ops_of<TOwner>::add_ref,
+                                                         &alias_owner_ops_of<TOwner>::release};
+
+} // namespace details
+
+/*
+ * Aliasing pointer.
+ *
+ * Points to a sub-object (a field of a message, a slice of a buffer) and
+ * keeps the reference of the object that owns it, like the aliasing
+ * constructor of shared_ptr, but without a control block: the owner is
+ * counted by its own intrusive counter.
+ *
+ * wstux::intrusive_ptr<message> p_msg = ...;
+ * wstux::aliasing_ptr<const header> p_header(p_msg, &p_msg->header);
+ *
+ * The type of the owner is erased, so the pointers to the same type of
+ * sub-object are interchangeable whatever owns them.
+ */
+template<typename T>
+class aliasing_ptr INTRUSIVE_TRIVIALLY_RELOCATABLE
+{
+    template<typename U>
+    friend class aliasing_ptr;
+
+public:
+    typedef T element_type;
+
+    aliasing_ptr() noexcept
+        : m_ptr(NULL)
+        , m_p_owner(NULL)
+        , m_p_ops(NULL)
+    {}
+
+    /* Takes the reference of 'owner'. */
+    template<typename TOwner>
+    aliasing_ptr(intrusive_ptr<TOwner> owner, element_type* ptr) noexcept
+        : m_ptr(ptr)
+        , m_p_owner(owner.detach())
+        , m_p_ops(&details::alias_owner_ops_of<TOwner>::ops)
+    {}
+
+    /* Shares the owner of 'owner'. */
+    template<typename U>
+    aliasing_ptr(const aliasing_ptr<U>& owner, element_type* ptr) noexcept
+        : m_ptr(ptr)
+        , m_p_owner(owner.m_p_owner)
+        , m_p_ops(owner.m_p_ops)
+    {
+        add_ref();
+    }
+
+    /* Points to the owner itself. */
+    template<typename U, typename = typename details::__enable_if_convertible<U*, T*>::type>
+    aliasing_ptr(intrusive_ptr<U> owner) noexcept
+        : m_ptr(owner.get())
+        , m_p_owner(owner.detach())
+        , m_p_ops(&details::alias_owner_ops_of<U>::ops)
+    {}
+
+    aliasing_ptr(const aliasing_ptr& rhs) noexcept
+        : m_ptr(rhs.m_ptr)
+        , m_p_owner(rhs.m_p_owner)
+        , m_p_ops(rhs.m_p_ops)
+    {
+        add_ref();
+    }
+
+    template<typename U, typename = typename details::__enable_if_convertible<U*, T*>::type>
+    aliasing_ptr(const aliasing_ptr<U>& rhs) noexcept
+        : m_ptr(rhs.m_ptr)
+        , m_p_owner(rhs.m_p_owner)
+        , m_p_ops(rhs.m_p_ops)
+    {
+        add_ref();
+    }
+
+    aliasing_ptr(aliasing_ptr&& rhs) noexcept
+        : m_ptr(rhs.m_ptr)
+        , m_p_owner(rhs.m_p_owner)
+        , m_p_ops(rhs.m_p_ops)
+    {
+        rhs.m_ptr = NULL;
+        rhs.m_p_owner = NULL;
+        rhs.m_p_ops = NULL;
+    }
+
+    ~aliasing_ptr() noexcept
+    {
+        if (m_p_owner != NULL) {
+            m_p_ops->release(m_p_owner);
+        }
+    }
+
+    aliasing_ptr& operator=(const aliasing_ptr& rhs) noexcept
+    {
+        aliasing_ptr(rhs).swap(*this);
+        return *this;
+    }
+
+    aliasing_ptr& operator=(aliasing_ptr&& rhs) noexcept
+    {
+        aliasing_ptr(static_cast<aliasing_ptr&&>(rhs)).swap(*this);
+        return *this;
+    }
+
+    element_type& operator*() const noexcept { assert(m_ptr != NULL); return *m_ptr; }
+
+    element_type* operator->() const noexcept { assert(m_ptr != NULL); return m_ptr; }
+
+    bool operator!() const noexcept { return (m_ptr == NULL); }
+
+    explicit operator bool () const noexcept { return (m_ptr != NULL); }
+
+    element_type* get() const noexcept { return m_ptr; }
+
+    /* Returns the owner, whose type is erased. */
+    const void* owner() const noexcept { return m_p_owner; }
+
+    void swap(aliasing_ptr& rhs) noexcept
+    {
+        element_type* p_tmp = m_ptr;
+        m_ptr = rhs.m_ptr;
+        rhs.m_ptr = p_tmp;
+
+        const void* p_owner = m_p_owner;
+        m_p_owner = rhs.m_p_owner;
+        rhs.m_p_owner = p_owner;
+
+        const details::alias_owner_ops* p_ops = m_p_ops;
+        m_p_ops = rhs.m_p_ops;
+        rhs.m_p_ops = p_ops;
+    }
+
+    void reset() noexcept { aliasing_ptr().swap(*this); }
+
+private:
+    void add_ref()
+    {
+        if (m_p_owner != NULL) {
+            m_p_ops->add_ref(m_p_owner);
+        }
+    }
+
+private:
+    element_type* m_ptr;
+    const void* m_p_owner;
+    const details::alias_owner_ops* m_p_ops;
+};
+
+template<typename T>
+struct is_trivially_relocatable<aliasing_ptr<T>> : std::true_type
+{};
+
+template<typename T, typename U>
+inline bool operator==(const aliasing_ptr<T>& lhs, const aliasing_ptr<U>& rhs) noexcept
+{
+    return lhs.get() == rhs.get();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const aliasing_ptr<T>& lhs, const aliasing_ptr<U>& rhs) noexcept
+{
+    return lhs.get() != rhs.get();
+}
+
+} // namespace wstux
+
+namespace std {
+
+template<typename T>
+void swap(::wstux::aliasing_ptr<T>& lhs, ::wstux::aliasing_ptr<T>& rhs) noexcept
+{
+    lhs.swap(rhs);
+}
+
+} // namespace std
+
+#endif /* _INTRUSIVE_ALIASING_PTR_H */
@@ -0,0 +1,195 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_ALLOCATE_INTRUSIVE_H
+#define _INTRUSIVE_ALLOCATE_INTRUSIVE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+namespace details {
+
+/* Header that precedes an object created with an allocator. */
+struct allocated_header
+{
+    void (*destroy)(void* p_object);
+};
+
+inline allocated_header* header_of(void* p_object)
+{
+    return reinterpret_cast<allocated_header*>(static_cast<char*>(p_object) - sizeof(allocated_header));
+}
+
+template<typename T>
+inline void* complete_object(const T* p, std::true_type /*is_polymorphic*/)
+{
+    return const_cast<void*>(dynamic_cast<const void*>(p));
+}
+
+template<typename T>
+inline void* complete_object(const T* p, std::false_type /*is_polymorphic*/)
+{
+    return const_cast<void*>(static_cast<const void*>(p));
+}
+
+/*
+ * Layout of the memory block of an object created with an allocator:
+ * [allocator][padding][header][object]
+ *
+ * The allocator is not stored if it is empty and default constructible.
+ */
+template<typename T, typename TAlloc>
+struct allocated_block
+{
+    static const size_t kAlign = std::max({alignof(T), alignof(allocated_header), alignof(TAlloc)});
+
+    typedef typename std::aligned_storage<kAlign, kAlign>::type unit_type;
+    typedef typename std::allocator_traits<TAlloc>::template rebind_alloc<unit_type> alloc_type;
+    typedef std::allocator_traits<alloc_type> alloc_traits;
+
+    static const bool kStoresAlloc = ! (std::is_empty<alloc_type>::value
+                                        && std::is_default_constructible<alloc_type>::value);
+    static const size_t kAllocSize = kStoresAlloc ? sizeof(alloc_type) : 0;
+    static const size_t kObjectOffset = (kAllocSize + sizeof(allocated_header) + kAlign - 1) / kAlign * kAlign;
+    static const size_t kUnitCount = (kObjectOffset + sizeof(T) + kAlign - 1) / kAlign;
+
+    static_assert(alignof(alloc_type) <= kAlign, "unsupported allocator alignment");
+
+    template<typename... TArgs>
+    static T* create(const TAlloc& a, TArgs&&... args)
+    {
+        alloc_type alloc(a);
+        unit_type* p_units = alloc_traits::allocate(alloc, kUnitCount);
+        char* p_base = reinterpret_cast<char*>(p_units);
+        ::new (p_base + kObjectOffset - sizeof(allocated_header)) allocated_header{&destroy};
+        T* p;
+        try {
+            p = ::new (p_base + kObjectOffset) T(std::forward<TArgs>(args)...);
+        } catch (...) {
+            alloc_traits::deallocate(alloc, p_units, kUnitCount);
+            throw;
+        }
+        store_alloc(p_base, alloc, std::integral_constant<bool, kStoresAlloc>());
+        return p;
+    }
+
+    static void destroy(void* p_object)
+    {
+        static_cast<T*>(p_object)->~T();
+
+        char* p_base = static_cast<char*>(p_object) - kObjectOffset;
+        alloc_type alloc(take_alloc(p_base, std::integral_constant<bool, kStoresAlloc>()));
+        alloc_traits::deallocate(alloc, reinterpret_cast<unit_type*>(p_base), kUnitCount);
+    }
+
+private:
+    static void store_alloc(char* p_base, alloc_type& alloc, std::true_type)
+    {
+        ::new (p_base) alloc_type(std::move(alloc));
+    }
+
+    static void store_alloc(char* /*p_base*/, alloc_type& /*alloc*/, std::false_type) {}
+
+    static alloc_type take_alloc(char* p_base, std::true_type)
+    {
+        alloc_type* p_alloc = reinterpret_cast<alloc_type*>(p_base);
+        alloc_type alloc(std::move(*p_alloc));
+        p_alloc->~alloc_type();
+        return alloc;
+    }
+
+    static alloc_type take_alloc(char* /*p_base*/, std::false_type) { return alloc_type(); }
+};
+
+} // namespace details
+
+/*
+ * Destroy policy of the objects created with an allocator. The allocator is
+ * stored in front of the object and the last release returns the memory to
+ * it. make_intrusive() uses the default allocator 'TAlloc' for such objects.
+ *
+ * class message : public wstux::intrusive_ref_counter<message,
+ *                                                     wstux::relaxed_atomic_counter_policy<size_t>,
+ *                                                     wstux::allocator_destroy_policy>
+ * { ... };
+ *
+ * Such objects must be created by make_intrusive() or allocate_intrusive()
+ * only. Like with the delete expression, an object of a derived class can be
+ * released through its base only if the base has the virtual destructor.
+ */
+template<typename TAlloc>
+struct basic_allocator_destroy_policy
+{
+    template<typename T, typename... TArgs>
+    static T* create(TArgs&&... args)
+    {
+        typedef typename std::allocator_traits<TAlloc>::template rebind_alloc<T> alloc_type;
+        return details::allocated_block<T, alloc_type>::create(alloc_type(),
+                                                               std::forward<TArgs>(args)...);
+    }
+
+    template<typename T>
+    static void destroy(const T* p)
+    {
+        void* p_object = details::complete_object(p, std::is_polymorphic<T>());
+        details::header_of(p_object)->destroy(p_object);
+    }
+};
+
+typedef basic_allocator_destroy_policy<std::allocator<char>> allocator_destroy_policy;
+
+namespace details {
+
+template<typename TPolicy>
+struct is_allocator_destroy_policy : std::false_type {};
+
+template<typename TAlloc>
+struct is_allocator_destroy_policy<basic_allocator_destroy_policy<TAlloc>> : std::true_type {};
+
+} // namespace details
+
+/* Creates the object with the memory of 'alloc', like std::allocate_shared. */
+template<typename T, typename TAlloc, typename... TArgs>
+inline intrusive_ptr<T> allocate_intrusive(const TAlloc& alloc, TArgs&&... args)
+{
+    typedef typename std::remove_const<T>::type T_nc;
+
+    static_assert(details::is_allocator_destroy_policy<
+                      typename details::intrusive_access::destroy_policy<T_nc>::type>::value,
+                  "object must use the allocator destroy policy");
+
+    return intrusive_ptr<T>(details::allocated_block<T_nc, TAlloc>::create(alloc,
+                                                                          std::forward<TArgs>(args)...));
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_ALLOCATE_INTRUSIVE_H */
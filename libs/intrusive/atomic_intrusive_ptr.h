@@ -0,0 +1,235 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_ATOMIC_INTRUSIVE_PTR_H
+#define _INTRUSIVE_ATOMIC_INTRUSIVE_PTR_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#include "intrusive/intrusive_ptr.h"
+
+#if defined(__has_feature)
+#if __has_feature(hwaddress_sanitizer)
+#define _INTRUSIVE_TAGGED_POINTERS
+#endif
+#endif
+#if defined(__SANITIZE_HWADDRESS__) || defined(__ARM_FEATURE_MEMORY_TAGGING)
+#define _INTRUSIVE_TAGGED_POINTERS
+#endif
+
+#ifdef _INTRUSIVE_TAGGED_POINTERS
+#error "the split pointer word doesn't support the tagged pointers (HWASan, MTE)"
+#endif
+
+namespace wstux {
+namespace details {
+
+/*
+ * The pointer is stored in the low bits of the word, the count of the readers
+ * that are taking a reference to it is stored in the high bits.
+ *
+ * User space pointers of the 64-bit platforms fit into 48 bits. The platforms
+ * where they don't are not supported: the tagged pointers (top byte ignore,
+ * memory tagging, HWASan) are rejected at compile time, the pointers above
+ * 48 bits (5-level paging with the high mmap hints) abort at runtime.
+ */
+struct split_ptr_word
+{
+    static_assert(sizeof(void*) <= 8, "pointer doesn't fit into the split word");
+
+    typedef uint64_t word_type;
+
+    static const unsigned kPtrBits = (sizeof(void*) == 8) ? 48 : 32;
+    static const word_type kPtrMask = (word_type(1) << kPtrBits) - 1;
+    static const word_type kOne = word_type(1) << kPtrBits;
+
+    /* The check is kept in the release builds, the wide pointer would
+     * silently become the count. */
+    static word_type pack(const void* p)
+    {
+        const word_type word = reinterpret_cast<uintptr_t>(p);
+        if ((word & ~kPtrMask) != 0) {
+            std::abort();
+        }
+        return word;
+    }
+
+    template<typename T>
+    static T* ptr(word_type word)
+    {
+        return reinterpret_cast<T*>(static_cast<uintptr_t>(word & kPtrMask));
+    }
+
+    static word_type count(word_type word) { return (word >> kPtrBits); }
+};
+
+} // namespace details
+
+/*
+ * Atomic intrusive pointer.
+ *
+ * The pointer and the count of the readers that are taking a reference to it
+ * share one atomic word (split reference count). A reader increments the
+ * count, which keeps the object alive, takes its own reference and gives the
+ * count back. A writer replaces the whole word and converts the count of the
+ * readers in progress to references of the object, so the readers that can't
+ * give the count back release these references instead.
+ *
+ * All operations are lock-free if the 64-bit atomic is lock-free and are
+ * sequentially consistent. Up to 65535 loads may be in progress at the same
+ * time on 64-bit platforms.
+ */
+template<typename T>
+class atomic_intrusive_ptr
+{
+    typedef details::split_ptr_word __word;
+    typedef typename __word::word_type __word_type;
+
+public:
+    typedef intrusive_ptr<T> value_type;
+
+    atomic_intrusive_ptr()
+        : m_word(0)
+    {}
+
+    atomic_intrusive_ptr(value_type desired)
+        : m_word(take(desired))
+    {}
+
+    atomic_intrusive_ptr(const atomic_intrusive_ptr&) = delete;
+    atomic_intrusive_ptr& operator=(const atomic_intrusive_ptr&) = delete;
+
+    ~atomic_intrusive_ptr()
+    {
+        const __word_type word = m_word.load(std::memory_order_relaxed);
+        assert(__word::count(word) == 0);
+        give_back(__word::ptr<T>(word));
+    }
+
+    atomic_intrusive_ptr& operator=(value_type desired)
+    {
+        store(std::move(desired));
+        return *this;
+    }
+
+    operator value_type() const { return load(); }
+
+    bool is_lock_free() const { return m_word.is_lock_free(); }
+
+    /* Returns the pointer without a reference. It is valid while the object
+     * can't be destroyed, e.g. inside of an epoch_guard for the objects with
+     * the epoch_destroy_policy. */
+    T* get() const { return __word::ptr<T>(m_word.load(std::memory_order_acquire)); }
+
+    value_type load() const
+    {
+        const __word_type word = m_word.fetch_add(__word::kOne, std::memory_order_seq_cst);
+        T* p = __word::ptr<T>(word);
+        value_type result(p);
+
+        __word_type cur = word + __word::kOne;
+        while (__word::ptr<T>(cur) == p && __word::count(cur) != 0) {
+            if (m_word.compare_exchange_weak(cur, cur - __word::kOne,
+                                             std::memory_order_relaxed,
+                                             std::memory_order_relaxed)) {
+                return result;
+            }
+        }
+        /* The pointer has been replaced and the writer has converted the count
+         * to a reference. The count of the same pointer published again is
+         * converted as well, the references of the same object are equal. */
+        if (p != NULL) {
+            intrusive_ptr_release(p);
+        }
+        return result;
+    }
+
+    void store(value_type desired) { exchange(std::move(desired)); }
+
+    value_type exchange(value_type desired)
+    {
+        const __word_type word = m_word.exchange(take(desired), std::memory_order_seq_cst);
+        return convert(word);
+    }
+
+    bool compare_exchange_strong(value_type& expected, value_type desired)
+    {
+        for (;;) {
+            __word_type cur = m_word.load(std::memory_order_seq_cst);
+            while (__word::ptr<T>(cur) == expected.get()) {
+                if (m_word.compare_exchange_weak(cur, __word::pack(desired.get()),
+                                                 std::memory_order_seq_cst,
+                                                 std::memory_order_seq_cst)) {
+                    take(desired);
+                    convert(cur);
+                    return true;
+                }
+            }
+            value_type current = load();
+            if (current != expected) {
+                expected = std::move(current);
+                return false;
+            }
+        }
+    }
+
+    bool compare_exchange_weak(value_type& expected, value_type desired)
+    {
+        return compare_exchange_strong(expected, std::move(desired));
+    }
+
+private:
+    /* Gives the reference of 'ptr' to the atomic pointer. */
+    static __word_type take(value_type& ptr) { return __word::pack(ptr.detach()); }
+
+    static void give_back(T* p)
+    {
+        if (p != NULL) {
+            intrusive_ptr_release(p);
+        }
+    }
+
+    /* Converts the count of the replaced word to references and returns the
+     * reference held by the atomic pointer. */
+    static value_type convert(__word_type word)
+    {
+        T* p = __word::ptr<T>(word);
+        if (p != NULL && __word::count(word) != 0) {
+            details::add_ref_n(p, static_cast<size_t>(__word::count(word)));
+        }
+        return value_type(p, false);
+    }
+
+private:
+    mutable std::atomic<__word_type> m_word;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_ATOMIC_INTRUSIVE_PTR_H */
@@ -0,0 +1,374 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_BIASED_COUNTER_H
+#define _INTRUSIVE_BIASED_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include "intrusive/intrusive_counter.h"
+
+namespace wstux {
+namespace details {
+
+/*
+ * Request to merge the counter of an object whose shared counter has become
+ * negative. The request holds the reference of the thread that has queued it.
+ */
+struct biased_merge_request
+{
+    biased_merge_request* p_next;
+    void (*process)(biased_merge_request*);
+    void* p_counter;
+    const void* p_object;
+};
+
+/*
+ * Owner record of a thread. It outlives the thread while there are objects
+ * that have been biased to the thread, even after their merge, so a non-owner
+ * thread may always queue a request to it. After the thread exit the queue is
+ * closed and the threads that release the object merge its counter themselves.
+ */
+class biased_owner
+{
+public:
+    biased_owner()
+        : m_refs(1)
+        , m_p_queue(NULL)
+    {}
+
+    void add_ref() { m_refs.fetch_add(1, std::memory_order_relaxed); }
+
+    void release()
+    {
+        if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    bool has_requests() const { return (m_p_queue.load(std::memory_order_relaxed) != NULL); }
+
+    void push(biased_merge_request* p_req)
+    {
+        biased_merge_request* p_head = m_p_queue.load(std::memory_order_acquire);
+        do {
+            if (p_head == closed()) {
+                p_req->process(p_req);
+                return;
+            }
+            p_req->p_next = p_head;
+        } while (! m_p_queue.compare_exchange_weak(p_head, p_req,
+                                                   std::memory_order_acq_rel,
+                                                   std::memory_order_acquire));
+    }
+
+    void merge_requests() { process(m_p_queue.exchange(NULL, std::memory_order_acq_rel)); }
+
+    void close() { process(m_p_queue.exchange(closed(), std::memory_order_acq_rel)); }
+
+private:
+    static biased_merge_request* closed()
+    {
+        static biased_merge_request closed_queue;
+        return &closed_queue;
+    }
+
+    static void process(biased_merge_request* p_req)
+    {
+        while (p_req != NULL) {
+            biased_merge_request* p_next = p_req->p_next;
+            p_req->process(p_req);
+            p_req = p_next;
+        }
+    }
+
+private:
+    std::atomic<size_t> m_refs;
+    std::atomic<biased_merge_request*> m_p_queue;
+};
+
+inline biased_owner*& current_biased_owner_ref()
+{
+    static thread_local biased_owner* p_owner = NULL;
+    return p_owner;
+}
+
+/* Closes the owner record of the current thread at the thread exit. */
+struct biased_owner_guard
+{
+    ~biased_owner_guard()
+    {
+        biased_owner* p_owner = current_biased_owner_ref();
+        current_biased_owner_ref() = closed_biased_owner();
+        p_owner->close();
+        p_owner->release();
+    }
+
+    static biased_owner* closed_biased_owner()
+    {
+        static biased_owner closed_owner;
+        return &closed_owner;
+    }
+};
+
+/* Returns the owner record of the current thread or NULL if the thread is
+ * being destroyed and can't own objects anymore. */
+inline biased_owner* current_biased_owner()
+{
+    biased_owner*& p_owner = current_biased_owner_ref();
+    if (p_owner == NULL) {
+        p_owner = new biased_owner();
+        static thread_local biased_owner_guard guard;
+        (void)guard;
+    }
+    return (p_owner != biased_owner_guard::closed_biased_owner()) ? p_owner : NULL;
+}
+
+template<typename T>
+inline void release_object(const void* p)
+{
+    intrusive_ptr_release(static_cast<T*>(const_cast<void*>(p)));
+}
+
+} // namespace details
+
+/*
+ * Biased counter for objects that are referenced mostly by one thread.
+ *
+ * The thread that has created the object owns it and counts its references
+ * in the local counter with plain loads and stores. The other threads use the
+ * shared atomic counter: the reference count is stored in the high bits, the
+ * lowest bits are 'merged' and 'queued' flags.
+ *
+ * When the owner releases its last local reference it merges the local
+ * counter into the shared one and gives up the ownership. If a non-owner
+ * thread releases a reference taken by the owner, the shared counter may
+ * become negative. Then the counter is queued to the owner, which merges it at
+ * the next object creation, at wstux::merge_biased_counters() or at the thread
+ * exit. After the merge all threads use the shared counter only.
+ */
+template<typename TValue = size_t>
+struct biased_counter_policy
+{
+    static_assert(std::is_integral<TValue>::value, "counter value must be integral");
+
+    typedef TValue value_type;
+
+    class counter_type
+    {
+        friend struct biased_counter_policy;
+
+        typedef typename std::make_signed<TValue>::type shared_type;
+
+    public:
+        explicit counter_type(value_type value)
+            : m_p_record(details::current_biased_owner())
+            , m_p_owner(m_p_record)
+            , m_local(value)
+            , m_shared(0)
+        {
+            if (m_p_record == NULL) {
+                m_local.store(0, std::memory_order_relaxed);
+                m_shared.store(shared_value(value) | kMerged, std::memory_order_relaxed);
+                return;
+            }
+            m_p_record->add_ref();
+            if (m_p_record->has_requests()) {
+                m_p_record->merge_requests();
+            }
+        }
+
+        ~counter_type()
+        {
+            if (m_p_record != NULL) {
+                m_p_record->release();
+            }
+        }
+
+        counter_type(const counter_type&) = delete;
+        counter_type& operator=(const counter_type&) = delete;
+
+    private:
+        /* The record of the creator thread. Is held until the counter is
+         * destroyed, the merge only resets 'm_p_owner'. */
+        details::biased_owner* const m_p_record;
+        std::atomic<details::biased_owner*> m_p_owner;
+        /* Is written by the owner thread only. It is atomic to make load()
+         * from the other threads well-defined, the owner never uses RMW. */
+        std::atomic<value_type> m_local;
+        std::atomic<shared_type> m_shared;
+    };
+
+    static value_type load(const counter_type& c)
+    {
+        return static_cast<value_type>(c.m_local.load(std::memory_order_relaxed)
+                                       + count(c.m_shared.load(std::memory_order_relaxed)));
+    }
+
+    static void increment(counter_type& c)
+    {
+        if (is_owner(c)) {
+            c.m_local.store(c.m_local.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+        } else {
+            c.m_shared.fetch_add(kOne, std::memory_order_relaxed);
+        }
+    }
+
+    template<typename T>
+    static bool decrement(counter_type& c, T* p)
+    {
+        if (is_owner(c)) {
+            const value_type local = c.m_local.load(std::memory_order_relaxed) - 1;
+            c.m_local.store(local, std::memory_order_relaxed);
+            if (local == 0) {
+                return (merge(c) == 0);
+            }
+            /* The object may be destroyed by the merge of its own request. */
+            details::biased_owner* p_owner = c.m_p_owner.load(std::memory_order_relaxed);
+            if (p_owner->has_requests()) {
+                p_owner->merge_requests();
+            }
+            return false;
+        }
+
+        typedef typename counter_type::shared_type shared_type;
+        shared_type shared = c.m_shared.load(std::memory_order_relaxed);
+        while ((shared & kMerged) == 0) {
+            shared_type desired = shared - kOne;
+            if (count(shared) != 0 || (shared & kQueued) != 0) {
+                if (c.m_shared.compare_exchange_weak(shared, desired,
+                                                     std::memory_order_release,
+                                                     std::memory_order_relaxed)) {
+                    return false;
+                }
+                continue;
+            }
+            /* The reference has been taken by the owner. Keep it until the
+             * owner merges the counter. The owner may merge concurrently, so
+             * the record is pinned before the request becomes visible. */
+            desired = shared | kQueued;
+            details::biased_owner* p_owner = c.m_p_record;
+            p_owner->add_ref();
+            if (c.m_shared.compare_exchange_weak(shared, desired,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+                queue(p_owner, c, p);
+                p_owner->release();
+                return false;
+            }
+            p_owner->release();
+        }
+
+        if (c.m_shared.fetch_sub(kOne, std::memory_order_release) != (kOne | kMerged)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+private:
+    static const int kMerged = 1;
+    static const int kQueued = 2;
+    static const int kOne = 4;
+
+    /* The flags are the low bits of the two's complement value, so the
+     * negative counter is '(count * kOne) | flags' as well. */
+    template<typename TShared>
+    static TShared count(TShared shared) { return ((shared - (shared & (kMerged | kQueued))) / kOne); }
+
+    static typename counter_type::shared_type shared_value(value_type value)
+    {
+        return static_cast<typename counter_type::shared_type>(value) * kOne;
+    }
+
+    static bool is_owner(const counter_type& c)
+    {
+        const details::biased_owner* p_owner = c.m_p_owner.load(std::memory_order_relaxed);
+        return (p_owner != NULL && p_owner == details::current_biased_owner_ref());
+    }
+
+    /* Is called by the owner thread, or by any thread after the owner exit.
+     * Returns the total count of references. */
+    static typename counter_type::shared_type merge(counter_type& c)
+    {
+        typedef typename counter_type::shared_type shared_type;
+
+        c.m_p_owner.store(NULL, std::memory_order_relaxed);
+        const shared_type local = shared_value(c.m_local.load(std::memory_order_relaxed));
+        c.m_local.store(0, std::memory_order_relaxed);
+
+        shared_type shared = c.m_shared.load(std::memory_order_relaxed);
+        shared_type desired;
+        do {
+            desired = ((shared & ~(kMerged | kQueued)) + local) | kMerged;
+        } while (! c.m_shared.compare_exchange_weak(shared, desired,
+                                                    std::memory_order_acq_rel,
+                                                    std::memory_order_relaxed));
+        return count(desired);
+    }
+
+    /* The request may be processed and the object destroyed before push()
+     * returns, so the owner record is pinned by the caller. */
+    template<typename T>
+    static void queue(details::biased_owner* p_owner, counter_type& c, T* p)
+    {
+        details::biased_merge_request* p_req = new details::biased_merge_request();
+        p_req->process = &process<T>;
+        p_req->p_counter = &c;
+        p_req->p_object = p;
+        p_owner->push(p_req);
+    }
+
+    template<typename T>
+    static void process(details::biased_merge_request* p_req)
+    {
+        counter_type& c = *static_cast<counter_type*>(p_req->p_counter);
+        const void* p_object = p_req->p_object;
+        delete p_req;
+
+        if (c.m_p_owner.load(std::memory_order_relaxed) != NULL) {
+            /* The request holds a reference, the merge can't destroy. */
+            merge(c);
+        }
+        details::release_object<T>(p_object);
+    }
+};
+
+/* Merges the counters of the objects owned by the current thread and released
+ * by the other threads. Threads that create biased objects rarely should call
+ * it periodically. */
+inline void merge_biased_counters()
+{
+    details::biased_owner* p_owner = details::current_biased_owner();
+    if (p_owner != NULL && p_owner->has_requests()) {
+        p_owner->merge_requests();
+    }
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_BIASED_COUNTER_H */
@@ -0,0 +1,193 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_BORROWED_PTR_H
+#define _INTRUSIVE_BORROWED_PTR_H
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/relocate.h"
+
+namespace wstux {
+
+/*
+ * Borrowed pointer.
+ *
+ * Non-owning view of an object owned by an intrusive_ptr, that is passed down
+ * the call chain instead of 'const intrusive_ptr<T>&' or of an intrusive_ptr
+ * by value and never touches the counter:
+ *
+ * void draw(wstux::borrowed_ptr<const shape> p_shape);
+ * ...
+ * wstux::intrusive_ptr<shape> ptr = ...;
+ * draw(ptr);
+ *
+ * The callee that keeps the object after the call promotes the borrowed
+ * pointer to an owning one. The borrowed pointer is trivially copyable.
+ *
+ * If INTRUSIVE_CHECK_BORROWS is defined for the whole program, the borrowed
+ * pointers are counted and releasing the last reference of a borrowed object
+ * fails the assertion.
+ */
+template<typename T>
+class borrowed_ptr INTRUSIVE_TRIVIALLY_RELOCATABLE
+{
+    template<typename U>
+    friend class borrowed_ptr;
+
+public:
+    typedef T element_type;
+
+    borrowed_ptr() noexcept
+        : m_ptr(NULL)
+    {}
+
+    template<typename U, typename = typename details::__enable_if_convertible<U*, T*>::type>
+    borrowed_ptr(const intrusive_ptr<U>& owner) noexcept
+        : m_ptr(owner.get())
+    {
+        add_borrow();
+    }
+
+    template<typename U, typename = typename details::__enable_if_convertible<U*, T*>::type>
+    borrowed_ptr(const borrowed_ptr<U>& rhs) noexcept
+        : m_ptr(rhs.m_ptr)
+    {
+        add_borrow();
+    }
+
+#ifdef INTRUSIVE_CHECK_BORROWS
+    borrowed_ptr(const borrowed_ptr& rhs) noexcept
+        : m_ptr(rhs.m_ptr)
+    {
+        add_borrow();
+    }
+
+    ~borrowed_ptr() noexcept { remove_borrow(); }
+
+    borrowed_ptr& operator=(const borrowed_ptr& rhs) noexcept
+    {
+        if (m_ptr != rhs.m_ptr) {
+            remove_borrow();
+            m_ptr = rhs.m_ptr;
+            add_borrow();
+        }
+        return *this;
+    }
+#else
+    borrowed_ptr(const borrowed_ptr&) = default;
+    ~borrowed_ptr() = default;
+    borrowed_ptr& operator=(const borrowed_ptr&) = default;
+#endif
+
+    element_type& operator*() const noexcept { assert(m_ptr != NULL); return *m_ptr; }
+
+    element_type* operator->() const noexcept { assert(m_ptr != NULL); return m_ptr; }
+
+    bool operator!() const noexcept { return (m_ptr == NULL); }
+
+    explicit operator bool () const noexcept { return (m_ptr != NULL); }
+
+    element_type* get() const noexcept { return m_ptr; }
+
+    /* Returns the owning pointer. The owner of the borrowed object is alive,
+     * so a new reference can be taken. */
+    intrusive_ptr<T> promote() const noexcept { return intrusive_ptr<T>(m_ptr); }
+
+private:
+#ifdef INTRUSIVE_CHECK_BORROWS
+    void add_borrow()
+    {
+        if (m_ptr != NULL) {
+            details::borrow_registry::instance().add(details::borrow_key(m_ptr));
+        }
+    }
+
+    void remove_borrow()
+    {
+        if (m_ptr != NULL) {
+            details::borrow_registry::instance().remove(details::borrow_key(m_ptr));
+        }
+    }
+#else
+    void add_borrow() {}
+#endif
+
+private:
+    element_type* m_ptr;
+};
+
+/* The borrows are counted per object, not per borrowed pointer. */
+template<typename T>
+struct is_trivially_relocatable<borrowed_ptr<T>> : std::true_type
+{};
+
+#ifndef INTRUSIVE_CHECK_BORROWS
+static_assert(std::is_trivially_copyable<borrowed_ptr<int>>::value,
+              "borrowed pointer must be trivially copyable");
+#endif
+
+template<typename T, typename U>
+inline bool operator==(const borrowed_ptr<T>& lhs, const borrowed_ptr<U>& rhs)
+{
+    return lhs.get() == rhs.get();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const borrowed_ptr<T>& lhs, const borrowed_ptr<U>& rhs)
+{
+    return lhs.get() != rhs.get();
+}
+
+template<typename T, typename U>
+inline bool operator==(const borrowed_ptr<T>& lhs, const intrusive_ptr<U>& rhs)
+{
+    return lhs.get() == rhs.get();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const borrowed_ptr<T>& lhs, const intrusive_ptr<U>& rhs)
+{
+    return lhs.get() != rhs.get();
+}
+
+template<typename T, typename U>
+inline bool operator==(const intrusive_ptr<T>& lhs, const borrowed_ptr<U>& rhs)
+{
+    return lhs.get() == rhs.get();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const intrusive_ptr<T>& lhs, const borrowed_ptr<U>& rhs)
+{
+    return lhs.get() != rhs.get();
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_BORROWED_PTR_H */
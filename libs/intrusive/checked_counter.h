@@ -0,0 +1,394 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_CHECKED_COUNTER_H
+#define _INTRUSIVE_CHECKED_COUNTER_H
+
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+#include "intrusive/intrusive_counter.h"
+
+namespace wstux {
+namespace details {
+
+/* Compares and sets the plain or the atomic counter. */
+template<typename TValue>
+inline bool counter_cas(TValue& c, TValue expected, TValue desired)
+{
+    if (c != expected) {
+        return false;
+    }
+    c = desired;
+    return true;
+}
+
+template<typename TValue>
+inline bool counter_cas(std::atomic<TValue>& c, TValue expected, TValue desired)
+{
+    return c.compare_exchange_strong(expected, desired, std::memory_order_release,
+                                     std::memory_order_relaxed);
+}
+
+template<typename TValue>
+inline TValue counter_load(const TValue& c) { return c; }
+
+template<typename TValue>
+inline TValue counter_load(const std::atomic<TValue>& c) { return c.load(std::memory_order_relaxed); }
+
+/* References above the maximum of the narrow counters, by the counter. */
+class spill_table
+{
+public:
+    static spill_table& instance()
+    {
+        static spill_table table;
+        return table;
+    }
+
+    std::mutex& mutex() { return m_mutex; }
+
+    /* The methods are called under the mutex. */
+    void add(const void* p_counter, size_t n = 1) { m_counts[p_counter] += n; }
+
+    /* Returns the count of the removed references, at most 'n'. */
+    size_t remove(const void* p_counter, size_t n = 1)
+    {
+        std::unordered_map<const void*, size_t>::iterator it = m_counts.find(p_counter);
+        if (it == m_counts.end()) {
+            return 0;
+        }
+        if (it->second <= n) {
+            n = it->second;
+            m_counts.erase(it);
+        } else {
+            it->second -= n;
+        }
+        return n;
+    }
+
+    size_t count(const void* p_counter) const
+    {
+        std::unordered_map<const void*, size_t>::const_iterator it = m_counts.find(p_counter);
+        return (it != m_counts.end()) ? it->second : 0;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::unordered_map<const void*, size_t> m_counts;
+};
+
+} // namespace details
+
+/*
+ * Overflow policies of the checked counters.
+ *
+ * A policy handles the counter that has reached the maximum of its type:
+ *  - increment_at_max(c, n) - adds 'n' references above the maximum. Returns
+ *                             true if the increment is done and false if the
+ *                             counter has changed and the increment must be
+ *                             repeated;
+ *  - decrement_at_max(c, n) - removes up to 'n' references from the counter
+ *                             at the maximum and returns their count, zero if
+ *                             the decrement must be repeated. The decrement
+ *                             from the maximum never reaches zero.
+ */
+
+/* The counter sticks to the maximum and the object is never destroyed. */
+struct saturate_on_overflow
+{
+    template<typename TCounter>
+    static bool increment_at_max(TCounter& /*c*/, size_t /*n*/ = 1) { return true; }
+
+    template<typename TCounter>
+    static size_t decrement_at_max(TCounter& /*c*/, size_t n = 1) { return n; }
+};
+
+/* The overflow is a fatal error. */
+struct abort_on_overflow
+{
+    template<typename TCounter>
+    static bool increment_at_max(TCounter& /*c*/, size_t /*n*/ = 1) { std::abort(); }
+
+    template<typename TCounter>
+    static size_t decrement_at_max(TCounter& c, size_t /*n*/ = 1)
+    {
+        const auto max = details::counter_load(c);
+        return details::counter_cas(c, max, decltype(max)(max - 1)) ? 1 : 0;
+    }
+};
+
+/*
+ * The references above the maximum are counted in the global side table.
+ * The table is used by the overflowed counters only and while the table has
+ * references of the counter, the counter stays at the maximum.
+ */
+struct spill_on_overflow
+{
+    template<typename TCounter>
+    static bool increment_at_max(TCounter& c, size_t n = 1)
+    {
+        details::spill_table& table = details::spill_table::instance();
+        std::lock_guard<std::mutex> lock(table.mutex());
+        if (! is_max(c)) {
+            return false;
+        }
+        table.add(&c, n);
+        return true;
+    }
+
+    template<typename TCounter>
+    static size_t decrement_at_max(TCounter& c, size_t n = 1)
+    {
+        details::spill_table& table = details::spill_table::instance();
+        std::lock_guard<std::mutex> lock(table.mutex());
+        const size_t removed = table.remove(&c, n);
+        if (removed != 0) {
+            return removed;
+        }
+        const auto max = details::counter_load(c);
+        return details::counter_cas(c, max, decltype(max)(max - 1)) ? 1 : 0;
+    }
+
+    /* Count of the references above the maximum. */
+    template<typename TCounter>
+    static size_t spilled(const TCounter& c)
+    {
+        details::spill_table& table = details::spill_table::instance();
+        std::lock_guard<std::mutex> lock(table.mutex());
+        return table.count(&c);
+    }
+
+private:
+    template<typename TCounter>
+    static bool is_max(const TCounter& c)
+    {
+        const auto value = details::counter_load(c);
+        return (value == std::numeric_limits<decltype(value)>::max());
+    }
+};
+
+/*
+ * Narrow non-atomic counter with the overflow check.
+ *
+ * class ast_node
+ * {
+ *     INIT_INTRUSIVE_PTR_WITH_POLICY(wstux::checked_counter_policy<uint16_t, wstux::spill_on_overflow>);
+ *     ...
+ * };
+ *
+ * load() returns the maximum for the overflowed counters.
+ */
+template<typename TValue = uint32_t, typename TOverflowPolicy = abort_on_overflow>
+struct checked_counter_policy
+{
+    static_assert(std::is_integral<TValue>::value && std::is_unsigned<TValue>::value,
+                  "counter value must be unsigned integral");
+
+    typedef TValue value_type;
+    typedef TValue counter_type;
+
+    static constexpr value_type kMax = std::numeric_limits<TValue>::max();
+
+    static value_type load(const counter_type& c) { return c; }
+
+    static void increment(counter_type& c)
+    {
+        while (c == kMax) {
+            if (TOverflowPolicy::increment_at_max(c)) {
+                return;
+            }
+        }
+        ++c;
+    }
+
+    static void increment(counter_type& c, value_type n)
+    {
+        while (n > 0) {
+            if (c == kMax) {
+                if (TOverflowPolicy::increment_at_max(c, n)) {
+                    return;
+                }
+                continue;
+            }
+            const value_type step = std::min<value_type>(n, kMax - c);
+            c += step;
+            n -= step;
+        }
+    }
+
+    static bool try_increment(counter_type& c)
+    {
+        if (c == 0) {
+            return false;
+        }
+        increment(c);
+        return true;
+    }
+
+    static bool decrement(counter_type& c)
+    {
+        while (c == kMax) {
+            if (TOverflowPolicy::decrement_at_max(c)) {
+                return false;
+            }
+        }
+        return (--c == 0);
+    }
+
+    static bool decrement(counter_type& c, value_type n)
+    {
+        while (c == kMax && n > 0) {
+            n -= static_cast<value_type>(TOverflowPolicy::decrement_at_max(c, n));
+        }
+        if (n == 0) {
+            return false;
+        }
+        return ((c -= n) == 0);
+    }
+};
+
+/*
+ * Narrow atomic counter with the overflow check. The counter is changed by
+ * the compare and swap, so it never wraps around.
+ */
+template<typename TValue = uint32_t, typename TOverflowPolicy = abort_on_overflow>
+struct checked_atomic_counter_policy
+{
+    static_assert(std::is_integral<TValue>::value && std::is_unsigned<TValue>::value,
+                  "counter value must be unsigned integral");
+
+    typedef TValue value_type;
+    typedef std::atomic<TValue> counter_type;
+
+    static constexpr value_type kMax = std::numeric_limits<TValue>::max();
+
+    static value_type load(const counter_type& c) { return c.load(std::memory_order_relaxed); }
+
+    static void increment(counter_type& c)
+    {
+        value_type value = c.load(std::memory_order_relaxed);
+        for (;;) {
+            if (value == kMax) {
+                if (TOverflowPolicy::increment_at_max(c)) {
+                    return;
+                }
+                value = c.load(std::memory_order_relaxed);
+            } else if (c.compare_exchange_weak(value, value + 1, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    static void increment(counter_type& c, value_type n)
+    {
+        value_type value = c.load(std::memory_order_relaxed);
+        while (n > 0) {
+            if (value == kMax) {
+                if (TOverflowPolicy::increment_at_max(c, n)) {
+                    return;
+                }
+                value = c.load(std::memory_order_relaxed);
+                continue;
+            }
+            const value_type step = std::min<value_type>(n, kMax - value);
+            if (c.compare_exchange_weak(value, value + step, std::memory_order_relaxed)) {
+                value += step;
+                n -= step;
+            }
+        }
+    }
+
+    /* The overflowed counter is never zero. */
+    static bool try_increment(counter_type& c)
+    {
+        value_type value = c.load(std::memory_order_relaxed);
+        for (;;) {
+            if (value == 0) {
+                return false;
+            }
+            if (value == kMax) {
+                increment(c);
+                return true;
+            }
+            if (c.compare_exchange_weak(value, value + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+    static bool decrement(counter_type& c)
+    {
+        value_type value = c.load(std::memory_order_relaxed);
+        for (;;) {
+            if (value == kMax) {
+                if (TOverflowPolicy::decrement_at_max(c)) {
+                    return false;
+                }
+                value = c.load(std::memory_order_relaxed);
+            } else if (c.compare_exchange_weak(value, value - 1, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        if (value != 1) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    static bool decrement(counter_type& c, value_type n)
+    {
+        value_type value = c.load(std::memory_order_relaxed);
+        for (;;) {
+            if (value == kMax) {
+                n -= static_cast<value_type>(TOverflowPolicy::decrement_at_max(c, n));
+                if (n == 0) {
+                    return false;
+                }
+                value = c.load(std::memory_order_relaxed);
+            } else if (c.compare_exchange_weak(value, value - n, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        if (value != n) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_CHECKED_COUNTER_H */
@@ -0,0 +1,350 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_CLOCK_CACHE_H
+#define _INTRUSIVE_CLOCK_CACHE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "intrusive/concurrent_hash_map.h"
+#include "intrusive/epoch.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+namespace details {
+
+/* Entry of a clock_cache, is both the chain link of the index and the slot of
+ * the ring. It holds the reference of the cache to the value until it is
+ * destroyed, i.e. until no reader can see it. */
+template<typename TKey, typename T>
+struct cache_node
+{
+    cache_node(const TKey& k, size_t h, T* p, size_t s, cache_node* p_n)
+        : key(k)
+        , hash(h)
+        , p_value(p)
+        , slot(s)
+        , is_referenced(false)
+        , p_next(p_n)
+        , retired()
+    {}
+
+    ~cache_node() { intrusive_ptr_release(p_value); }
+
+    const TKey key;
+    const size_t hash;
+    T* const p_value;
+    /* Is guarded by the shard mutex. */
+    size_t slot;
+    std::atomic<bool> is_referenced;
+    std::atomic<cache_node*> p_next;
+    epoch_retired retired;
+};
+
+/* Spreads the hash over all bits. The standard hash of the integers is the
+ * identity, so the keys that differ in the high bits only would share a shard
+ * and evict each other. */
+inline size_t mix_cache_hash(size_t hash)
+{
+    uint64_t h = hash;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+} // namespace details
+
+/*
+ * Concurrent cache of intrusive pointers with the CLOCK eviction.
+ *
+ * A hit takes no lock and moves nothing: the entry is found inside of an
+ * epoch_guard, its 'referenced' bit is set and the reference of the value is
+ * taken, no other shared word is written. Each of 'TShards' shards has a
+ * fixed table of buckets, a ring of entries and a mutex taken by the writers.
+ * An insertion into the full shard sweeps the ring from the hand: the
+ * referenced entries get a second chance, the first unreferenced one is
+ * evicted.
+ *
+ * The eviction drops the reference of the cache only, the values returned by
+ * find() stay alive until their users release them. The evicted entry is
+ * destroyed by the epoch domain, after the readers that could see it have
+ * left:
+ *
+ * wstux::clock_cache<std::string, image> cache(4096);
+ * wstux::intrusive_ptr<image> p = cache.find(name);
+ * if (! p) {
+ *     p = decode(name);
+ *     cache.insert(name, p);
+ * }
+ *
+ * The capacity is split evenly between the shards, so it is rounded up to
+ * a multiple of 'TShards'.
+ */
+template<typename TKey,
+         typename T,
+         typename THash = std::hash<TKey>,
+         typename TEqual = std::equal_to<TKey>,
+         size_t TShards = 16>
+class clock_cache
+{
+    static_assert(TShards > 0 && (TShards & (TShards - 1)) == 0,
+                  "shards count must be a power of two");
+
+    typedef details::cache_node<TKey, T> __node_type;
+    typedef details::map_table<__node_type> __table_type;
+
+    struct alignas(64) shard
+    {
+        __table_type* p_table;
+        std::vector<__node_type*> ring;
+        size_t hand;
+        size_t size;
+        std::mutex mutex;
+    };
+
+public:
+    typedef TKey key_type;
+    typedef intrusive_ptr<T> value_type;
+
+    explicit clock_cache(size_t capacity)
+        : m_shard_capacity((capacity + TShards - 1) / TShards)
+        , m_size(0)
+    {
+        assert(capacity > 0);
+        size_t bucket_count = 1;
+        while (bucket_count < m_shard_capacity) {
+            bucket_count *= 2;
+        }
+        for (size_t i = 0; i < TShards; ++i) {
+            m_shards[i].p_table = new __table_type(bucket_count);
+            m_shards[i].ring.resize(m_shard_capacity, NULL);
+            m_shards[i].hand = 0;
+            m_shards[i].size = 0;
+        }
+    }
+
+    clock_cache(const clock_cache&) = delete;
+    clock_cache& operator=(const clock_cache&) = delete;
+
+    /* No reader may use the cache anymore. */
+    ~clock_cache()
+    {
+        for (size_t i = 0; i < TShards; ++i) {
+            delete m_shards[i].p_table;
+        }
+    }
+
+    size_t capacity() const { return m_shard_capacity * TShards; }
+
+    size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+    bool empty() const { return (size() == 0); }
+
+    /* Returns the value or the empty pointer. Takes no lock. */
+    value_type find(const key_type& key) const
+    {
+        const size_t hash = details::mix_cache_hash(THash()(key));
+        epoch_guard guard;
+        __node_type* p_node = find_node(shard_of(hash), key, hash);
+        if (p_node == NULL) {
+            return value_type();
+        }
+        /* The hot entry keeps its cache line shared. */
+        if (! p_node->is_referenced.load(std::memory_order_relaxed)) {
+            p_node->is_referenced.store(true, std::memory_order_relaxed);
+        }
+        return value_type(p_node->p_value);
+    }
+
+    bool contains(const key_type& key) const
+    {
+        const size_t hash = details::mix_cache_hash(THash()(key));
+        epoch_guard guard;
+        return (find_node(shard_of(hash), key, hash) != NULL);
+    }
+
+    /* Inserts the value if the key is not in the cache. May evict an entry of
+     * the same shard. */
+    bool insert(const key_type& key, value_type ptr)
+    {
+        assert(ptr);
+        const size_t hash = details::mix_cache_hash(THash()(key));
+        shard& s = shard_of(hash);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (find_link(s, key, hash) != NULL) {
+            return false;
+        }
+        link(s, make_node(key, hash, ptr));
+        return true;
+    }
+
+    /* Inserts the value or replaces the value of the key. */
+    void insert_or_assign(const key_type& key, value_type ptr)
+    {
+        assert(ptr);
+        const size_t hash = details::mix_cache_hash(THash()(key));
+        shard& s = shard_of(hash);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        std::atomic<__node_type*>* p_link = find_link(s, key, hash);
+        if (p_link == NULL) {
+            link(s, make_node(key, hash, ptr));
+            return;
+        }
+        /* The entry is immutable for the readers, it is replaced by a new one. */
+        __node_type* p_old = p_link->load(std::memory_order_relaxed);
+        __node_type* p_node = new __node_type(key, hash, ptr.detach(), p_old->slot,
+                                              p_old->p_next.load(std::memory_order_relaxed));
+        s.ring[p_node->slot] = p_node;
+        p_link->store(p_node, std::memory_order_release);
+        retire(p_old);
+    }
+
+    /* Removes the key and returns its value. */
+    value_type erase(const key_type& key)
+    {
+        const size_t hash = details::mix_cache_hash(THash()(key));
+        shard& s = shard_of(hash);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        std::atomic<__node_type*>* p_link = find_link(s, key, hash);
+        if (p_link == NULL) {
+            return value_type();
+        }
+        __node_type* p_node = p_link->load(std::memory_order_relaxed);
+        value_type result(p_node->p_value);
+        unlink(s, p_link);
+        return result;
+    }
+
+private:
+    shard& shard_of(size_t hash) const { return m_shards[hash & (TShards - 1)]; }
+
+    /* The low bits select the shard. */
+    static size_t bucket_hash(size_t hash) { return hash / TShards; }
+
+    /* Is called inside of an epoch_guard. */
+    static __node_type* find_node(const shard& s, const key_type& key, size_t hash)
+    {
+        for (__node_type* p_node = s.p_table->bucket(bucket_hash(hash)).load(std::memory_order_acquire);
+             p_node != NULL; p_node = p_node->p_next.load(std::memory_order_acquire)) {
+            if (p_node->hash == hash && TEqual()(p_node->key, key)) {
+                return p_node;
+            }
+        }
+        return NULL;
+    }
+
+    /* Returns the link to the node of the key. Is called under the mutex. */
+    static std::atomic<__node_type*>* find_link(shard& s, const key_type& key, size_t hash)
+    {
+        for (std::atomic<__node_type*>* p_link = &s.p_table->bucket(bucket_hash(hash));; ) {
+            __node_type* p_node = p_link->load(std::memory_order_relaxed);
+            if (p_node == NULL) {
+                return NULL;
+            }
+            if (p_node->hash == hash && TEqual()(p_node->key, key)) {
+                return p_link;
+            }
+            p_link = &p_node->p_next;
+        }
+    }
+
+    /* The node is allocated before an entry is evicted, so the failed
+     * insertion leaves the shard as it was. */
+    static __node_type* make_node(const key_type& key, size_t hash, value_type& ptr)
+    {
+        __node_type* p_node = new __node_type(key, hash, ptr.get(), 0, NULL);
+        ptr.detach();
+        return p_node;
+    }
+
+    void link(shard& s, __node_type* p_node)
+    {
+        std::atomic<__node_type*>& bucket = s.p_table->bucket(bucket_hash(p_node->hash));
+        p_node->slot = free_slot(s);
+        p_node->p_next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        s.ring[p_node->slot] = p_node;
+        bucket.store(p_node, std::memory_order_release);
+        ++s.size;
+        m_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /* The readers on the node still see the rest of the chain. */
+    void unlink(shard& s, std::atomic<__node_type*>* p_link)
+    {
+        __node_type* p_node = p_link->load(std::memory_order_relaxed);
+        p_link->store(p_node->p_next.load(std::memory_order_relaxed), std::memory_order_release);
+        s.ring[p_node->slot] = NULL;
+        --s.size;
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        retire(p_node);
+    }
+
+    /* Returns the empty slot of the shard, evicts an entry if the shard is
+     * full. */
+    size_t free_slot(shard& s)
+    {
+        for (;; s.hand = (s.hand + 1) % m_shard_capacity) {
+            __node_type* p_node = s.ring[s.hand];
+            if (p_node == NULL) {
+                break;
+            }
+            if (s.size < m_shard_capacity) {
+                continue;
+            }
+            if (p_node->is_referenced.load(std::memory_order_relaxed)) {
+                p_node->is_referenced.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            unlink(s, find_link(s, p_node->key, p_node->hash));
+            break;
+        }
+        const size_t slot = s.hand;
+        s.hand = (s.hand + 1) % m_shard_capacity;
+        return slot;
+    }
+
+    static void retire(__node_type* p_node)
+    {
+        details::epoch_domain::instance().retire(details::current_epoch_record(), &p_node->retired,
+                                                 p_node, &destroy);
+    }
+
+    static void destroy(const void* p) { delete static_cast<const __node_type*>(p); }
+
+private:
+    const size_t m_shard_capacity;
+    mutable shard m_shards[TShards];
+    std::atomic<size_t> m_size;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_CLOCK_CACHE_H */
@@ -0,0 +1,315 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_CONCURRENT_HASH_MAP_H
+#define _INTRUSIVE_CONCURRENT_HASH_MAP_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+#include "intrusive/epoch.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+namespace details {
+
+/* Entry of a concurrent_hash_map. It holds a reference of the value until the
+ * entry is destroyed, i.e. until no reader can see it. */
+template<typename TKey, typename T>
+struct map_node
+{
+    map_node(const TKey& k, size_t h, T* p, map_node* p_n)
+        : key(k)
+        , hash(h)
+        , p_value(p)
+        , p_next(p_n)
+        , retired()
+    {}
+
+    ~map_node() { intrusive_ptr_release(p_value); }
+
+    const TKey key;
+    const size_t hash;
+    T* const p_value;
+    std::atomic<map_node*> p_next;
+    epoch_retired retired;
+};
+
+/* Buckets of a shard. The table is replaced as a whole when the shard grows.
+ * The node is a chain link with 'p_next'. */
+template<typename TNode>
+struct map_table
+{
+    typedef TNode node_type;
+
+    explicit map_table(size_t count)
+        : mask(count - 1)
+        , p_buckets(new std::atomic<node_type*>[count])
+        , retired()
+    {
+        for (size_t i = 0; i < count; ++i) {
+            p_buckets[i].store(NULL, std::memory_order_relaxed);
+        }
+    }
+
+    /* Destroys the nodes as well. */
+    ~map_table()
+    {
+        for (size_t i = 0; i <= mask; ++i) {
+            node_type* p_node = p_buckets[i].load(std::memory_order_relaxed);
+            while (p_node != NULL) {
+                node_type* p_next = p_node->p_next.load(std::memory_order_relaxed);
+                delete p_node;
+                p_node = p_next;
+            }
+        }
+        delete[] p_buckets;
+    }
+
+    std::atomic<node_type*>& bucket(size_t hash) { return p_buckets[hash & mask]; }
+
+    const size_t mask;
+    std::atomic<node_type*>* const p_buckets;
+    epoch_retired retired;
+};
+
+} // namespace details
+
+/*
+ * Concurrent hash map of intrusive pointers, optimized for reading.
+ *
+ * The map is split into 'TShards' shards selected by the hash of the key.
+ * Writers of a shard are serialized by its mutex, readers take no lock: a
+ * lookup walks the chain inside of an epoch_guard and takes a reference of
+ * the found value.
+ *
+ * The reference taken by a reader is always safe: the removed entry keeps
+ * the reference of the map to the value until it is destroyed by the epoch
+ * domain, after all readers that could see it have left their guards. So the
+ * value of a visible entry is never released to zero. The shard grows by
+ * building a new table of entries and retiring the old one.
+ *
+ * wstux::concurrent_hash_map<uint64_t, session> registry;
+ * registry.insert(id, p_session);
+ * wstux::intrusive_ptr<session> p = registry.find(id);
+ */
+template<typename TKey,
+         typename T,
+         typename THash = std::hash<TKey>,
+         typename TEqual = std::equal_to<TKey>,
+         size_t TShards = 64>
+class concurrent_hash_map
+{
+    static_assert(TShards > 0 && (TShards & (TShards - 1)) == 0,
+                  "shards count must be a power of two");
+
+    typedef details::map_node<TKey, T> __node_type;
+    typedef details::map_table<__node_type> __table_type;
+
+    static const size_t kInitialBuckets = 16;
+    static const size_t kMaxLoadFactor = 2;
+
+    struct alignas(64) shard
+    {
+        std::atomic<__table_type*> p_table;
+        size_t size;
+        std::mutex mutex;
+    };
+
+public:
+    typedef TKey key_type;
+    typedef intrusive_ptr<T> value_type;
+
+    concurrent_hash_map()
+        : m_size(0)
+    {
+        for (size_t i = 0; i < TShards; ++i) {
+            m_shards[i].p_table.store(new __table_type(kInitialBuckets), std::memory_order_relaxed);
+            m_shards[i].size = 0;
+        }
+    }
+
+    concurrent_hash_map(const concurrent_hash_map&) = delete;
+    concurrent_hash_map& operator=(const concurrent_hash_map&) = delete;
+
+    /* No reader may use the map anymore. */
+    ~concurrent_hash_map()
+    {
+        for (size_t i = 0; i < TShards; ++i) {
+            delete m_shards[i].p_table.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+    bool empty() const { return (size() == 0); }
+
+    /* Returns the value or the empty pointer. Takes no lock. */
+    value_type find(const key_type& key) const
+    {
+        const size_t hash = THash()(key);
+        epoch_guard guard;
+        __table_type* p_table = shard_of(hash).p_table.load(std::memory_order_acquire);
+        for (__node_type* p_node = p_table->bucket(bucket_hash(hash)).load(std::memory_order_acquire);
+             p_node != NULL; p_node = p_node->p_next.load(std::memory_order_acquire)) {
+            if (p_node->hash == hash && TEqual()(p_node->key, key)) {
+                return value_type(p_node->p_value);
+            }
+        }
+        return value_type();
+    }
+
+    bool contains(const key_type& key) const { return static_cast<bool>(find(key)); }
+
+    /* Inserts the value if the key is not in the map. */
+    bool insert(const key_type& key, value_type ptr)
+    {
+        assert(ptr);
+        const size_t hash = THash()(key);
+        shard& s = shard_of(hash);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        __table_type* p_table = s.p_table.load(std::memory_order_relaxed);
+        std::atomic<__node_type*>& bucket = p_table->bucket(bucket_hash(hash));
+        if (find_locked(bucket, key, hash) != NULL) {
+            return false;
+        }
+        bucket.store(new __node_type(key, hash, ptr.detach(), bucket.load(std::memory_order_relaxed)),
+                     std::memory_order_release);
+        grow(s);
+        return true;
+    }
+
+    /* Inserts the value or replaces the value of the key. */
+    void insert_or_assign(const key_type& key, value_type ptr)
+    {
+        assert(ptr);
+        const size_t hash = THash()(key);
+        shard& s = shard_of(hash);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        __table_type* p_table = s.p_table.load(std::memory_order_relaxed);
+        std::atomic<__node_type*>& bucket = p_table->bucket(bucket_hash(hash));
+        std::atomic<__node_type*>* p_link = find_locked(bucket, key, hash);
+        if (p_link == NULL) {
+            bucket.store(new __node_type(key, hash, ptr.detach(), bucket.load(std::memory_order_relaxed)),
+                         std::memory_order_release);
+            grow(s);
+            return;
+        }
+        /* The entry is immutable, it is replaced by a new one. */
+        __node_type* p_old = p_link->load(std::memory_order_relaxed);
+        p_link->store(new __node_type(key, hash, ptr.detach(), p_old->p_next.load(std::memory_order_relaxed)),
+                      std::memory_order_release);
+        retire(p_old);
+    }
+
+    /* Removes the key and returns its value. */
+    value_type erase(const key_type& key)
+    {
+        const size_t hash = THash()(key);
+        shard& s = shard_of(hash);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        __table_type* p_table = s.p_table.load(std::memory_order_relaxed);
+        std::atomic<__node_type*>* p_link = find_locked(p_table->bucket(bucket_hash(hash)), key, hash);
+        if (p_link == NULL) {
+            return value_type();
+        }
+        __node_type* p_node = p_link->load(std::memory_order_relaxed);
+        /* The readers on the node still see the rest of the chain. */
+        p_link->store(p_node->p_next.load(std::memory_order_relaxed), std::memory_order_release);
+        --s.size;
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        value_type result(p_node->p_value);
+        retire(p_node);
+        return result;
+    }
+
+private:
+    shard& shard_of(size_t hash) const { return m_shards[hash & (TShards - 1)]; }
+
+    /* The low bits select the shard. */
+    static size_t bucket_hash(size_t hash) { return hash / TShards; }
+
+    /* Returns the link to the node of the key. */
+    static std::atomic<__node_type*>* find_locked(std::atomic<__node_type*>& bucket,
+                                                 const key_type& key, size_t hash)
+    {
+        for (std::atomic<__node_type*>* p_link = &bucket;; ) {
+            __node_type* p_node = p_link->load(std::memory_order_relaxed);
+            if (p_node == NULL) {
+                return NULL;
+            }
+            if (p_node->hash == hash && TEqual()(p_node->key, key)) {
+                return p_link;
+            }
+            p_link = &p_node->p_next;
+        }
+    }
+
+    /* Counts the inserted node and doubles the table of an overloaded shard.
+     * The readers of the old table finish on it. */
+    void grow(shard& s)
+    {
+        ++s.size;
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        __table_type* p_old = s.p_table.load(std::memory_order_relaxed);
+        if (s.size <= (p_old->mask + 1) * kMaxLoadFactor) {
+            return;
+        }
+        __table_type* p_table = new __table_type((p_old->mask + 1) * 2);
+        for (size_t i = 0; i <= p_old->mask; ++i) {
+            for (__node_type* p_node = p_old->p_buckets[i].load(std::memory_order_relaxed);
+                 p_node != NULL; p_node = p_node->p_next.load(std::memory_order_relaxed)) {
+                std::atomic<__node_type*>& bucket = p_table->bucket(bucket_hash(p_node->hash));
+                intrusive_ptr_add_ref(p_node->p_value);
+                bucket.store(new __node_type(p_node->key, p_node->hash, p_node->p_value,
+                                             bucket.load(std::memory_order_relaxed)),
+                             std::memory_order_relaxed);
+            }
+        }
+        s.p_table.store(p_table, std::memory_order_release);
+        details::epoch_domain::instance().retire(details::current_epoch_record(), &p_old->retired,
+                                                 p_old, &destroy<__table_type>);
+    }
+
+    static void retire(__node_type* p_node)
+    {
+        details::epoch_domain::instance().retire(details::current_epoch_record(), &p_node->retired,
+                                                 p_node, &destroy<__node_type>);
+    }
+
+    template<typename TObject>
+    static void destroy(const void* p) { delete static_cast<const TObject*>(p); }
+
+private:
+    mutable shard m_shards[TShards];
+    std::atomic<size_t> m_size;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_CONCURRENT_HASH_MAP_H */
@@ -0,0 +1,135 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_COW_PTR_H
+#define _INTRUSIVE_COW_PTR_H
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/relocate.h"
+
+namespace wstux {
+
+/*
+ * Copy-on-write pointer.
+ *
+ * Copies of the pointer share the object for reading. The first write access
+ * through a pointer that is not the only owner of the object clones the
+ * object with its copy constructor, so the defensive deep copies of values
+ * that are rarely changed are made only when they are really changed:
+ *
+ * wstux::cow_ptr<config> cfg = wstux::make_cow<config>();
+ * wstux::cow_ptr<config> copy = cfg;   // shares the object
+ * copy.write()->timeout = 10;          // clones the object
+ *
+ * The object must provide the intrusive_ptr_is_unique() hook, it is generated
+ * by intrusive_ref_counter and by the INIT_INTRUSIVE_PTR_* macros. The pointer
+ * itself is not thread safe, like intrusive_ptr, but the copies of it may be
+ * used by different threads.
+ */
+template<typename T>
+class cow_ptr INTRUSIVE_TRIVIALLY_RELOCATABLE
+{
+public:
+    typedef T element_type;
+
+    cow_ptr() noexcept = default;
+
+    explicit cow_ptr(intrusive_ptr<T> ptr) noexcept
+        : m_ptr(std::move(ptr))
+    {}
+
+    const element_type& operator*() const noexcept { assert(m_ptr); return *m_ptr; }
+
+    const element_type* operator->() const noexcept { assert(m_ptr); return m_ptr.get(); }
+
+    bool operator!() const noexcept { return ! m_ptr; }
+
+    explicit operator bool () const noexcept { return static_cast<bool>(m_ptr); }
+
+    const element_type* get() const noexcept { return m_ptr.get(); }
+
+    /* Returns true if no other pointer shares the object. */
+    bool is_unique() const noexcept { return (m_ptr && intrusive_ptr_is_unique(m_ptr.get())); }
+
+    /* Returns the object for writing. The shared object is cloned first. */
+    element_type* write()
+    {
+        assert(m_ptr);
+        if (! intrusive_ptr_is_unique(m_ptr.get())) {
+            m_ptr = make_intrusive<T>(static_cast<const T&>(*m_ptr));
+        }
+        return m_ptr.get();
+    }
+
+    /* Returns a read only owning pointer that shares the object. */
+    intrusive_ptr<const T> share() const noexcept { return intrusive_ptr<const T>(m_ptr); }
+
+    void swap(cow_ptr& rhs) noexcept { m_ptr.swap(rhs.m_ptr); }
+
+    void reset() noexcept { m_ptr.reset(); }
+
+private:
+    intrusive_ptr<T> m_ptr;
+};
+
+template<typename T>
+struct is_trivially_relocatable<cow_ptr<T>> : std::true_type
+{};
+
+template<typename T, typename U>
+inline bool operator==(const cow_ptr<T>& lhs, const cow_ptr<U>& rhs) noexcept
+{
+    return lhs.get() == rhs.get();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const cow_ptr<T>& lhs, const cow_ptr<U>& rhs) noexcept
+{
+    return lhs.get() != rhs.get();
+}
+
+template<typename T, typename... TArgs>
+inline cow_ptr<T> make_cow(TArgs&&... args)
+{
+    return cow_ptr<T>(make_intrusive<T>(std::forward<TArgs>(args)...));
+}
+
+} // namespace wstux
+
+namespace std {
+
+template<typename T>
+void swap(::wstux::cow_ptr<T>& lhs, ::wstux::cow_ptr<T>& rhs) noexcept
+{
+    lhs.swap(rhs);
+}
+
+} // namespace std
+
+#endif /* _INTRUSIVE_COW_PTR_H */
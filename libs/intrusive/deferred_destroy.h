@@ -0,0 +1,236 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_DEFERRED_DESTROY_H
+#define _INTRUSIVE_DEFERRED_DESTROY_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "intrusive/intrusive_counter.h"
+
+namespace wstux {
+namespace details {
+
+/* Object whose counter has reached zero and that waits for the destruction. */
+struct reclaim_node
+{
+    reclaim_node* p_next;
+    void (*destroy)(const void* p_object);
+    const void* p_object;
+};
+
+/*
+ * Global queue of the objects to destroy. The releasing threads push the
+ * objects with one CAS, the draining thread takes the whole queue at once.
+ */
+class reclaim_queue
+{
+public:
+    static reclaim_queue& instance()
+    {
+        static reclaim_queue queue;
+        return queue;
+    }
+
+    void push(reclaim_node* p_node) { push(p_node, p_node); }
+
+    size_t drain(size_t max_count)
+    {
+        size_t count = 0;
+        while (count < max_count) {
+            reclaim_node* p_node = m_p_head.exchange(NULL, std::memory_order_acquire);
+            if (p_node == NULL) {
+                break;
+            }
+            p_node = reverse(p_node);
+            while (p_node != NULL && count < max_count) {
+                /* The node lives in the object and dies with it. */
+                reclaim_node* p_next = p_node->p_next;
+                p_node->destroy(p_node->p_object);
+                p_node = p_next;
+                ++count;
+            }
+            if (p_node != NULL) {
+                /* The rest of the batch is returned to the queue, 'p_node'
+                 * becomes its last node. */
+                push(reverse(p_node), p_node);
+            }
+        }
+        return count;
+    }
+
+    bool empty() const { return (m_p_head.load(std::memory_order_relaxed) == NULL); }
+
+private:
+    reclaim_queue()
+        : m_p_head(NULL)
+    {}
+
+    void push(reclaim_node* p_first, reclaim_node* p_last)
+    {
+        reclaim_node* p_head = m_p_head.load(std::memory_order_relaxed);
+        do {
+            p_last->p_next = p_head;
+        } while (! m_p_head.compare_exchange_weak(p_head, p_first,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+    }
+
+    static reclaim_node* reverse(reclaim_node* p_node)
+    {
+        reclaim_node* p_prev = NULL;
+        while (p_node != NULL) {
+            reclaim_node* p_next = p_node->p_next;
+            p_node->p_next = p_prev;
+            p_prev = p_node;
+            p_node = p_next;
+        }
+        return p_prev;
+    }
+
+private:
+    std::atomic<reclaim_node*> m_p_head;
+};
+
+} // namespace details
+
+/* Link of the object in the queue of the objects to destroy. */
+struct deferred_hook
+{
+    deferred_hook() noexcept
+        : reclaim_node()
+    {}
+
+    /* The link belongs to the queue, not to the value of the object. */
+    deferred_hook(const deferred_hook&) noexcept
+        : reclaim_node()
+    {}
+
+    deferred_hook& operator=(const deferred_hook&) noexcept { return *this; }
+
+    details::reclaim_node reclaim_node;
+};
+
+/*
+ * Destroy policy that doesn't destroy the object in the releasing thread. The
+ * object is queued and is destroyed by drain_deferred() or by the background
+ * deferred_reclaimer, with the destroy policy 'TDestroyPolicy'.
+ *
+ * The object is linked into the queue by its deferred_hook, so the release
+ * never allocates and never throws:
+ *
+ * class graph : public wstux::intrusive_ref_counter<graph,
+ *                                                   wstux::relaxed_atomic_counter_policy<size_t>,
+ *                                                   wstux::deferred_destroy_policy<>>
+ *             , public wstux::deferred_hook
+ * { ... };
+ */
+template<typename TDestroyPolicy = delete_destroy_policy>
+struct deferred_destroy_policy
+{
+    template<typename T, typename... TArgs>
+    static T* create(TArgs&&... args)
+    {
+        return TDestroyPolicy::template create<T>(std::forward<TArgs>(args)...);
+    }
+
+    template<typename T>
+    static void destroy(const T* p) noexcept
+    {
+        static_assert(std::is_base_of<deferred_hook, T>::value,
+                      "object with the deferred destroy must have the deferred_hook");
+
+        details::reclaim_node* p_node =
+            &const_cast<deferred_hook*>(static_cast<const deferred_hook*>(p))->reclaim_node;
+        p_node->destroy = &destroy_now<T>;
+        p_node->p_object = p;
+        details::reclaim_queue::instance().push(p_node);
+    }
+
+private:
+    template<typename T>
+    static void destroy_now(const void* p) { TDestroyPolicy::destroy(static_cast<const T*>(p)); }
+};
+
+/* Destroys up to 'max_count' queued objects, including the objects queued by
+ * the destructors of the drained ones. Returns the count of destroyed objects. */
+inline size_t drain_deferred(size_t max_count = std::numeric_limits<size_t>::max())
+{
+    return details::reclaim_queue::instance().drain(max_count);
+}
+
+/* Background thread that drains the queued objects periodically. The rest
+ * of the queue is drained by the destructor. */
+class deferred_reclaimer
+{
+public:
+    explicit deferred_reclaimer(std::chrono::milliseconds period = std::chrono::milliseconds(1))
+        : m_is_stopped(false)
+        , m_thread([this, period]() { run(period); })
+    {}
+
+    deferred_reclaimer(const deferred_reclaimer&) = delete;
+    deferred_reclaimer& operator=(const deferred_reclaimer&) = delete;
+
+    ~deferred_reclaimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopped = true;
+        }
+        m_cond.notify_one();
+        m_thread.join();
+        drain_deferred();
+    }
+
+private:
+    void run(std::chrono::milliseconds period)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (! m_is_stopped) {
+            m_cond.wait_for(lock, period);
+            lock.unlock();
+            drain_deferred();
+            lock.lock();
+        }
+    }
+
+private:
+    bool m_is_stopped;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_DEFERRED_DESTROY_H */
@@ -0,0 +1,66 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_ENABLE_INTRUSIVE_FROM_THIS_H
+#define _INTRUSIVE_ENABLE_INTRUSIVE_FROM_THIS_H
+
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+
+/*
+ * Base class for objects that return owning pointers to themselves.
+ *
+ * class connection : public wstux::intrusive_ref_counter<connection>
+ *                  , public wstux::enable_intrusive_from_this<connection>
+ * {
+ *     void start() { loop.post(intrusive_from_this()); }
+ * };
+ *
+ * Unlike enable_shared_from_this, the base is empty: the counter is a part of
+ * the object, so a new reference is taken from the pointer itself. The object
+ * must be owned by an intrusive_ptr, otherwise the returned pointer destroys
+ * it when released.
+ */
+template<typename T>
+class enable_intrusive_from_this
+{
+public:
+    intrusive_ptr<T> intrusive_from_this() noexcept { return intrusive_ptr<T>(static_cast<T*>(this)); }
+
+    intrusive_ptr<const T> intrusive_from_this() const noexcept
+    {
+        return intrusive_ptr<const T>(static_cast<const T*>(this));
+    }
+
+protected:
+    enable_intrusive_from_this() = default;
+    enable_intrusive_from_this(const enable_intrusive_from_this&) = default;
+    enable_intrusive_from_this& operator=(const enable_intrusive_from_this&) = default;
+    ~enable_intrusive_from_this() = default;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_ENABLE_INTRUSIVE_FROM_THIS_H */
@@ -0,0 +1,391 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_EPOCH_H
+#define _INTRUSIVE_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "intrusive/intrusive_counter.h"
+
+namespace wstux {
+namespace details {
+
+/* Object retired at the epoch. The node lives in the retired object. */
+struct epoch_retired
+{
+    epoch_retired* p_next;
+    void (*destroy)(const void* p_object);
+    const void* p_object;
+    uint64_t epoch;
+};
+
+/*
+ * Record of a thread. The announced epoch is 'epoch * 2 + 1' while the thread
+ * is inside of a guard and zero otherwise. The records are never freed, the
+ * record of an exited thread is reused by a new one.
+ */
+struct epoch_record
+{
+    epoch_record()
+        : announced(0)
+        , is_used(true)
+        , nesting(0)
+        , p_retired(NULL)
+        , retired_count(0)
+        , p_next(NULL)
+    {}
+
+    alignas(64) std::atomic<uint64_t> announced;
+    std::atomic<bool> is_used;
+    size_t nesting;
+    epoch_retired* p_retired;
+    size_t retired_count;
+    epoch_record* p_next;
+};
+
+/*
+ * Epoch based reclamation.
+ *
+ * An object retired at the epoch 'e' may be seen only by the readers that have
+ * entered the epoch 'e' or earlier. The global epoch advances when all active
+ * readers have entered the current one, so the object is destroyed when the
+ * global epoch reaches 'e + 2'.
+ */
+class epoch_domain
+{
+public:
+    static const size_t kCollectThreshold = 64;
+
+    static epoch_domain& instance()
+    {
+        static epoch_domain domain;
+        return domain;
+    }
+
+    void enter(epoch_record* p_record)
+    {
+        if (p_record->nesting++ == 0) {
+            const uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+            p_record->announced.store(epoch * 2 + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void exit(epoch_record* p_record)
+    {
+        if (--p_record->nesting == 0) {
+            p_record->announced.store(0, std::memory_order_release);
+        }
+    }
+
+    void retire(epoch_record* p_record, epoch_retired* p_retired,
+                const void* p_object, void (*destroy)(const void*)) noexcept
+    {
+        p_retired->destroy = destroy;
+        p_retired->p_object = p_object;
+        p_retired->epoch = m_epoch.load(std::memory_order_seq_cst);
+
+        if (p_record == NULL) {
+            std::lock_guard<std::mutex> lock(m_orphans_mutex);
+            p_retired->p_next = m_p_orphans;
+            m_p_orphans = p_retired;
+            return;
+        }
+        p_retired->p_next = p_record->p_retired;
+        p_record->p_retired = p_retired;
+        if (++p_record->retired_count >= kCollectThreshold) {
+            collect(p_record);
+        }
+    }
+
+    /* Tries to advance the epoch and destroys the safe objects of the record
+     * and the orphaned objects. */
+    void collect(epoch_record* p_record)
+    {
+        try_advance();
+        const uint64_t safe_epoch = m_epoch.load(std::memory_order_acquire) - 2;
+        if (p_record != NULL) {
+            epoch_retired* p_retired = p_record->p_retired;
+            p_record->p_retired = NULL;
+            p_record->retired_count = 0;
+            destroy_safe(p_retired, safe_epoch, p_record);
+        }
+
+        std::unique_lock<std::mutex> lock(m_orphans_mutex, std::try_to_lock);
+        if (lock.owns_lock() && m_p_orphans != NULL) {
+            epoch_retired* p_retired = m_p_orphans;
+            m_p_orphans = NULL;
+            lock.unlock();
+            destroy_safe(p_retired, safe_epoch, p_record);
+        }
+    }
+
+    epoch_record* acquire_record()
+    {
+        for (epoch_record* p_record = m_p_records.load(std::memory_order_acquire);
+             p_record != NULL; p_record = p_record->p_next) {
+            bool is_used = false;
+            if (! p_record->is_used.load(std::memory_order_relaxed)
+                && p_record->is_used.compare_exchange_strong(is_used, true, std::memory_order_acquire)) {
+                return p_record;
+            }
+        }
+        epoch_record* p_record = new epoch_record();
+        epoch_record* p_head = m_p_records.load(std::memory_order_relaxed);
+        do {
+            p_record->p_next = p_head;
+        } while (! m_p_records.compare_exchange_weak(p_head, p_record,
+                                                     std::memory_order_release,
+                                                     std::memory_order_relaxed));
+        return p_record;
+    }
+
+    /* The retired objects of the record are orphaned, they are destroyed by
+     * the other threads. */
+    void release_record(epoch_record* p_record)
+    {
+        epoch_retired* p_retired = p_record->p_retired;
+        p_record->p_retired = NULL;
+        p_record->retired_count = 0;
+        if (p_retired != NULL) {
+            epoch_retired* p_last = p_retired;
+            while (p_last->p_next != NULL) {
+                p_last = p_last->p_next;
+            }
+            std::lock_guard<std::mutex> lock(m_orphans_mutex);
+            p_last->p_next = m_p_orphans;
+            m_p_orphans = p_retired;
+        }
+        p_record->is_used.store(false, std::memory_order_release);
+    }
+
+private:
+    epoch_domain()
+        : m_epoch(2)
+        , m_p_records(NULL)
+        , m_p_orphans(NULL)
+    {}
+
+    void try_advance()
+    {
+        uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (epoch_record* p_record = m_p_records.load(std::memory_order_acquire);
+             p_record != NULL; p_record = p_record->p_next) {
+            const uint64_t announced = p_record->announced.load(std::memory_order_acquire);
+            if (announced != 0 && announced != epoch * 2 + 1) {
+                return;
+            }
+        }
+        m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+    }
+
+    /* The destroyed objects may retire other objects, they are added to the
+     * record after the list has been detached from it. */
+    void destroy_safe(epoch_retired* p_retired, uint64_t safe_epoch, epoch_record* p_record)
+    {
+        while (p_retired != NULL) {
+            epoch_retired* p_next = p_retired->p_next;
+            if (p_retired->epoch <= safe_epoch) {
+                /* The node dies with the object. */
+                p_retired->destroy(p_retired->p_object);
+            } else if (p_record != NULL) {
+                p_retired->p_next = p_record->p_retired;
+                p_record->p_retired = p_retired;
+                ++p_record->retired_count;
+            } else {
+                std::lock_guard<std::mutex> lock(m_orphans_mutex);
+                p_retired->p_next = m_p_orphans;
+                m_p_orphans = p_retired;
+            }
+            p_retired = p_next;
+        }
+    }
+
+private:
+    std::atomic<uint64_t> m_epoch;
+    std::atomic<epoch_record*> m_p_records;
+    std::mutex m_orphans_mutex;
+    epoch_retired* m_p_orphans;
+};
+
+/* Record of the current thread, NULL after the thread exit. */
+struct epoch_record_holder
+{
+    epoch_record_holder()
+        : p_record(epoch_domain::instance().acquire_record())
+    {
+        current() = p_record;
+    }
+
+    ~epoch_record_holder()
+    {
+        epoch_record* p = p_record;
+        p_record = NULL;
+        current() = NULL;
+        is_destroyed() = true;
+        epoch_domain::instance().release_record(p);
+    }
+
+    static epoch_record*& current()
+    {
+        static thread_local epoch_record* p_current = NULL;
+        return p_current;
+    }
+
+    static bool& is_destroyed()
+    {
+        static thread_local bool destroyed = false;
+        return destroyed;
+    }
+
+    epoch_record* p_record;
+};
+
+inline epoch_record* current_epoch_record()
+{
+    if (epoch_record_holder::is_destroyed()) {
+        return NULL;
+    }
+    static thread_local epoch_record_holder holder;
+    return holder.p_record;
+}
+
+/* Record of the current thread or NULL if the thread has none yet. Never
+ * allocates the record. */
+inline epoch_record* existing_epoch_record() noexcept
+{
+    return epoch_record_holder::current();
+}
+
+} // namespace details
+
+/*
+ * Epoch guard of a reader.
+ *
+ * Objects with the epoch_destroy_policy, that the reader has reached inside of
+ * the guard, are not destroyed until the guard is left, so the reader may use
+ * raw pointers to them without touching their counters:
+ *
+ * {
+ *     wstux::epoch_guard guard;
+ *     const route* p_route = table.get();
+ *     ...
+ * }
+ *
+ * Guards may be nested.
+ */
+class epoch_guard
+{
+public:
+    epoch_guard()
+        : m_p_record(details::current_epoch_record())
+    {
+        if (m_p_record != NULL) {
+            details::epoch_domain::instance().enter(m_p_record);
+        }
+    }
+
+    epoch_guard(const epoch_guard&) = delete;
+    epoch_guard& operator=(const epoch_guard&) = delete;
+
+    ~epoch_guard()
+    {
+        if (m_p_record != NULL) {
+            details::epoch_domain::instance().exit(m_p_record);
+        }
+    }
+
+private:
+    details::epoch_record* m_p_record;
+};
+
+/* Link of the object in the list of the retired objects. */
+struct epoch_hook
+{
+    epoch_hook() noexcept
+        : epoch_retired()
+    {}
+
+    /* The link belongs to the domain, not to the value of the object. */
+    epoch_hook(const epoch_hook&) noexcept
+        : epoch_retired()
+    {}
+
+    epoch_hook& operator=(const epoch_hook&) noexcept { return *this; }
+
+    details::epoch_retired epoch_retired;
+};
+
+/*
+ * Destroy policy that retires the object to the epoch domain. The object is
+ * destroyed with 'TDestroyPolicy' when no reader can see it anymore.
+ *
+ * The object is linked into the domain by its epoch_hook, so the release
+ * never allocates and never throws. The objects released by a thread, that
+ * has never used the domain, are orphaned and are destroyed by the collection
+ * of the other threads.
+ */
+template<typename TDestroyPolicy = delete_destroy_policy>
+struct epoch_destroy_policy
+{
+    template<typename T, typename... TArgs>
+    static T* create(TArgs&&... args)
+    {
+        return TDestroyPolicy::template create<T>(std::forward<TArgs>(args)...);
+    }
+
+    template<typename T>
+    static void destroy(const T* p) noexcept
+    {
+        static_assert(std::is_base_of<epoch_hook, T>::value,
+                      "object with the epoch destroy must have the epoch_hook");
+
+        details::epoch_retired* p_retired =
+            &const_cast<epoch_hook*>(static_cast<const epoch_hook*>(p))->epoch_retired;
+        details::epoch_domain::instance().retire(details::existing_epoch_record(), p_retired,
+                                                 p, &destroy_now<T>);
+    }
+
+private:
+    template<typename T>
+    static void destroy_now(const void* p) { TDestroyPolicy::destroy(static_cast<const T*>(p)); }
+};
+
+/* Destroys the objects retired by the current thread that are safe to
+ * destroy. Is called automatically every 64 retired objects. */
+inline void collect_epoch()
+{
+    details::epoch_domain::instance().collect(details::current_epoch_record());
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_EPOCH_H */
@@ -0,0 +1,532 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_HAZARD_POINTER_H
+#define _INTRUSIVE_HAZARD_POINTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "intrusive/atomic_intrusive_ptr.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+namespace details {
+
+/* Object whose counter has reached zero and that may still be protected. The
+ * node lives in the retired object. */
+struct hazard_retired
+{
+    hazard_retired* p_next;
+    void (*destroy)(const void* p_object);
+    const void* p_object;
+};
+
+/*
+ * Hazard slots of a thread. The records are never freed, the record of an
+ * exited thread is reused by a new one.
+ */
+struct hazard_record
+{
+    static const size_t kSlotCount = 4;
+
+    hazard_record()
+        : used_mask(0)
+        , is_used(true)
+        , p_retired(NULL)
+        , retired_count(0)
+        , p_hazards(NULL)
+        , hazard_capacity(0)
+        , is_scanning(false)
+        , p_next(NULL)
+    {
+        for (size_t i = 0; i < kSlotCount; ++i) {
+            slots[i].store(NULL, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<const void*>* acquire_slot()
+    {
+        for (size_t i = 0; i < kSlotCount; ++i) {
+            if ((used_mask & (1u << i)) == 0) {
+                used_mask |= (1u << i);
+                return &slots[i];
+            }
+        }
+        return NULL;
+    }
+
+    void release_slot(std::atomic<const void*>* p_slot)
+    {
+        used_mask &= ~(1u << (p_slot - slots));
+    }
+
+    alignas(64) std::atomic<const void*> slots[kSlotCount];
+    unsigned used_mask;
+    std::atomic<bool> is_used;
+    hazard_retired* p_retired;
+    size_t retired_count;
+    /* Sorted snapshot of the hazard slots for the scans of the owner. It is
+     * reserved out of the release path, so the scan never allocates. */
+    const void** p_hazards;
+    size_t hazard_capacity;
+    bool is_scanning;
+    hazard_record* p_next;
+};
+
+/*
+ * Hazard pointer reclamation.
+ *
+ * A reader publishes the pointer in its hazard slot and validates that the
+ * pointer is still in the shared slot. A retired object is destroyed by the
+ * scan that doesn't find it in the hazard slots, so a stalled reader keeps
+ * only the objects it protects, not all retired ones.
+ */
+class hazard_domain
+{
+public:
+    static const size_t kScanThreshold = 64;
+
+    static hazard_domain& instance()
+    {
+        static hazard_domain domain;
+        return domain;
+    }
+
+    void retire(hazard_record* p_record, hazard_retired* p_retired,
+                const void* p_object, void (*destroy)(const void*)) noexcept
+    {
+        p_retired->destroy = destroy;
+        p_retired->p_object = p_object;
+
+        if (p_record == NULL) {
+            std::lock_guard<std::mutex> lock(m_orphans_mutex);
+            p_retired->p_next = m_p_orphans;
+            m_p_orphans = p_retired;
+            return;
+        }
+        p_retired->p_next = p_record->p_retired;
+        p_record->p_retired = p_retired;
+        if (++p_record->retired_count >= kScanThreshold) {
+            scan(p_record);
+        }
+    }
+
+    /* Destroys the unprotected objects of the record and the orphaned
+     * objects. The scan, that is nested into the destructor of an object
+     * destroyed by the scan of the same record, is skipped. */
+    void scan(hazard_record* p_record) noexcept
+    {
+        if (p_record != NULL && p_record->is_scanning) {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        hazard_snapshot hazards = { NULL, 0 };
+        if (p_record != NULL) {
+            p_record->is_scanning = true;
+            hazards = take_snapshot(p_record);
+            hazard_retired* p_retired = p_record->p_retired;
+            p_record->p_retired = NULL;
+            p_record->retired_count = 0;
+            destroy_unprotected(p_retired, hazards, p_record);
+        }
+
+        std::unique_lock<std::mutex> lock(m_orphans_mutex, std::try_to_lock);
+        if (lock.owns_lock() && m_p_orphans != NULL) {
+            hazard_retired* p_retired = m_p_orphans;
+            m_p_orphans = NULL;
+            lock.unlock();
+            destroy_unprotected(p_retired, hazards, p_record);
+        }
+        if (p_record != NULL) {
+            p_record->is_scanning = false;
+        }
+    }
+
+    /* Grows the snapshot buffer of the record up to the count of the slots of
+     * the domain. Is called out of the release path. */
+    void reserve_hazards(hazard_record* p_record)
+    {
+        const size_t count = m_record_count.load(std::memory_order_relaxed) * hazard_record::kSlotCount;
+        if (p_record->hazard_capacity >= count || p_record->is_scanning) {
+            return;
+        }
+        const void** p_hazards = new const void*[count * 2];
+        delete[] p_record->p_hazards;
+        p_record->p_hazards = p_hazards;
+        p_record->hazard_capacity = count * 2;
+    }
+
+    hazard_record* acquire_record()
+    {
+        for (hazard_record* p_record = m_p_records.load(std::memory_order_acquire);
+             p_record != NULL; p_record = p_record->p_next) {
+            bool is_used = false;
+            if (! p_record->is_used.load(std::memory_order_relaxed)
+                && p_record->is_used.compare_exchange_strong(is_used, true, std::memory_order_acquire)) {
+                return p_record;
+            }
+        }
+        hazard_record* p_record = new hazard_record();
+        m_record_count.fetch_add(1, std::memory_order_relaxed);
+        reserve_hazards(p_record);
+        hazard_record* p_head = m_p_records.load(std::memory_order_relaxed);
+        do {
+            p_record->p_next = p_head;
+        } while (! m_p_records.compare_exchange_weak(p_head, p_record,
+                                                     std::memory_order_release,
+                                                     std::memory_order_relaxed));
+        return p_record;
+    }
+
+    /* The retired objects of the record are orphaned, they are destroyed by
+     * the other threads. */
+    void release_record(hazard_record* p_record)
+    {
+        hazard_retired* p_retired = p_record->p_retired;
+        p_record->p_retired = NULL;
+        p_record->retired_count = 0;
+        if (p_retired != NULL) {
+            hazard_retired* p_last = p_retired;
+            while (p_last->p_next != NULL) {
+                p_last = p_last->p_next;
+            }
+            std::lock_guard<std::mutex> lock(m_orphans_mutex);
+            p_last->p_next = m_p_orphans;
+            m_p_orphans = p_retired;
+        }
+        p_record->is_used.store(false, std::memory_order_release);
+    }
+
+private:
+    /* Sorted hazards or NULL if they don't fit the buffer of the record. */
+    struct hazard_snapshot
+    {
+        const void** p_hazards;
+        size_t count;
+    };
+
+    hazard_domain()
+        : m_p_records(NULL)
+        , m_record_count(0)
+        , m_p_orphans(NULL)
+    {}
+
+    /* The records added after the last reserve_hazards() may not fit the
+     * buffer, then the scan walks the slots for every retired object. */
+    hazard_snapshot take_snapshot(hazard_record* p_record) const
+    {
+        hazard_snapshot hazards = { p_record->p_hazards, 0 };
+        for (hazard_record* p = m_p_records.load(std::memory_order_acquire); p != NULL; p = p->p_next) {
+            for (size_t i = 0; i < hazard_record::kSlotCount; ++i) {
+                const void* p_object = p->slots[i].load(std::memory_order_acquire);
+                if (p_object == NULL) {
+                    continue;
+                }
+                if (hazards.count == p_record->hazard_capacity) {
+                    return hazard_snapshot{ NULL, 0 };
+                }
+                hazards.p_hazards[hazards.count++] = p_object;
+            }
+        }
+        std::sort(hazards.p_hazards, hazards.p_hazards + hazards.count);
+        return hazards;
+    }
+
+    bool is_protected(const hazard_snapshot& hazards, const void* p_object) const
+    {
+        if (hazards.p_hazards != NULL) {
+            return std::binary_search(hazards.p_hazards, hazards.p_hazards + hazards.count, p_object);
+        }
+        for (hazard_record* p = m_p_records.load(std::memory_order_acquire); p != NULL; p = p->p_next) {
+            for (size_t i = 0; i < hazard_record::kSlotCount; ++i) {
+                if (p->slots[i].load(std::memory_order_acquire) == p_object) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /* The destroyed objects may retire other objects, they are added to the
+     * record after the list has been detached from it. */
+    void destroy_unprotected(hazard_retired* p_retired, const hazard_snapshot& hazards,
+                             hazard_record* p_record)
+    {
+        while (p_retired != NULL) {
+            hazard_retired* p_next = p_retired->p_next;
+            if (! is_protected(hazards, p_retired->p_object)) {
+                /* The node dies with the object. */
+                p_retired->destroy(p_retired->p_object);
+            } else if (p_record != NULL) {
+                p_retired->p_next = p_record->p_retired;
+                p_record->p_retired = p_retired;
+                ++p_record->retired_count;
+            } else {
+                std::lock_guard<std::mutex> lock(m_orphans_mutex);
+                p_retired->p_next = m_p_orphans;
+                m_p_orphans = p_retired;
+            }
+            p_retired = p_next;
+        }
+    }
+
+private:
+    std::atomic<hazard_record*> m_p_records;
+    std::atomic<size_t> m_record_count;
+    std::mutex m_orphans_mutex;
+    hazard_retired* m_p_orphans;
+};
+
+/* Record of the current thread, NULL after the thread exit. */
+struct hazard_record_holder
+{
+    hazard_record_holder()
+        : p_record(hazard_domain::instance().acquire_record())
+    {
+        current() = p_record;
+    }
+
+    ~hazard_record_holder()
+    {
+        hazard_record* p = p_record;
+        p_record = NULL;
+        current() = NULL;
+        is_destroyed() = true;
+        hazard_domain::instance().release_record(p);
+    }
+
+    static bool& is_destroyed()
+    {
+        static thread_local bool destroyed = false;
+        return destroyed;
+    }
+
+    static hazard_record*& current()
+    {
+        static thread_local hazard_record* p_current = NULL;
+        return p_current;
+    }
+
+    hazard_record* p_record;
+};
+
+inline hazard_record* current_hazard_record()
+{
+    if (hazard_record_holder::is_destroyed()) {
+        return NULL;
+    }
+    static thread_local hazard_record_holder holder;
+    return holder.p_record;
+}
+
+/* Record of the current thread or NULL if the thread has none yet. Never
+ * allocates the record. */
+inline hazard_record* existing_hazard_record() noexcept
+{
+    return hazard_record_holder::current();
+}
+
+} // namespace details
+
+/*
+ * Hazard pointer of a reader.
+ *
+ * Protects one object with the hazard_destroy_policy, loaded from a shared
+ * slot, from the destruction without touching its counter. The reader that
+ * needs the object after the critical section promotes it to an owning
+ * pointer:
+ *
+ * wstux::hazard_pointer hp;
+ * const route* p_route = hp.protect(table);
+ * ...
+ * wstux::intrusive_ptr<route> ptr = hp.promote(table);
+ *
+ * Every thread has four slots, the next hazard pointers take a separate
+ * record of the domain.
+ */
+class hazard_pointer
+{
+public:
+    hazard_pointer()
+        : m_p_record(details::current_hazard_record())
+        , m_p_slot(NULL)
+        , m_is_own_record(false)
+    {
+        if (m_p_record != NULL) {
+            m_p_slot = m_p_record->acquire_slot();
+        }
+        if (m_p_slot == NULL) {
+            m_p_record = details::hazard_domain::instance().acquire_record();
+            m_p_slot = m_p_record->acquire_slot();
+            m_is_own_record = true;
+        }
+        details::hazard_domain::instance().reserve_hazards(m_p_record);
+    }
+
+    hazard_pointer(const hazard_pointer&) = delete;
+    hazard_pointer& operator=(const hazard_pointer&) = delete;
+
+    ~hazard_pointer()
+    {
+        reset();
+        m_p_record->release_slot(m_p_slot);
+        if (m_is_own_record) {
+            details::hazard_domain::instance().release_record(m_p_record);
+        }
+    }
+
+    /* Returns the pointer of the slot that stays valid until the hazard
+     * pointer is reset or protects another object. */
+    template<typename T>
+    T* protect(const atomic_intrusive_ptr<T>& src)
+    {
+        return protect_impl<T>([&src]() { return src.get(); });
+    }
+
+    template<typename T>
+    T* protect(const std::atomic<T*>& src)
+    {
+        return protect_impl<T>([&src]() { return src.load(std::memory_order_acquire); });
+    }
+
+    /* Returns the owning pointer to the protected object if it is still
+     * published in the slot and an empty pointer otherwise. The shared word of
+     * the slot is not touched. */
+    template<typename T>
+    intrusive_ptr<T> promote(const atomic_intrusive_ptr<T>& src) const
+    {
+        T* p = static_cast<T*>(const_cast<void*>(m_p_slot->load(std::memory_order_relaxed)));
+        if (p == NULL || src.get() != p) {
+            return intrusive_ptr<T>();
+        }
+        return intrusive_ptr<T>::try_acquire(p);
+    }
+
+    /* Returns the owning pointer to the protected object 'p' if it is still
+     * alive, even if it has been unpublished, and an empty pointer otherwise. */
+    template<typename T>
+    intrusive_ptr<T> promote(T* p) const
+    {
+        assert(p == m_p_slot->load(std::memory_order_relaxed));
+        return intrusive_ptr<T>::try_acquire(p);
+    }
+
+    void reset() { m_p_slot->store(NULL, std::memory_order_release); }
+
+private:
+    template<typename T, typename TLoad>
+    T* protect_impl(TLoad load)
+    {
+        T* p = load();
+        for (;;) {
+            m_p_slot->store(p, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            T* p_cur = load();
+            if (p_cur == p) {
+                return p;
+            }
+            p = p_cur;
+        }
+    }
+
+private:
+    details::hazard_record* m_p_record;
+    std::atomic<const void*>* m_p_slot;
+    bool m_is_own_record;
+};
+
+/* Link of the object in the list of the retired objects. */
+struct hazard_hook
+{
+    hazard_hook() noexcept
+        : hazard_retired()
+    {}
+
+    /* The link belongs to the domain, not to the value of the object. */
+    hazard_hook(const hazard_hook&) noexcept
+        : hazard_retired()
+    {}
+
+    hazard_hook& operator=(const hazard_hook&) noexcept { return *this; }
+
+    details::hazard_retired hazard_retired;
+};
+
+/*
+ * Destroy policy that retires the object to the hazard domain. The object is
+ * destroyed with 'TDestroyPolicy' when no hazard pointer protects it.
+ *
+ * The object is linked into the domain by its hazard_hook and the scan uses
+ * the snapshot buffer reserved by the hazard pointers, so the release never
+ * allocates and never throws. The objects released by a thread, that has
+ * never used the domain, are orphaned and are destroyed by the scans of the
+ * other threads.
+ */
+template<typename TDestroyPolicy = delete_destroy_policy>
+struct hazard_destroy_policy
+{
+    template<typename T, typename... TArgs>
+    static T* create(TArgs&&... args)
+    {
+        return TDestroyPolicy::template create<T>(std::forward<TArgs>(args)...);
+    }
+
+    template<typename T>
+    static void destroy(const T* p) noexcept
+    {
+        static_assert(std::is_base_of<hazard_hook, T>::value,
+                      "object with the hazard destroy must have the hazard_hook");
+
+        details::hazard_retired* p_retired =
+            &const_cast<hazard_hook*>(static_cast<const hazard_hook*>(p))->hazard_retired;
+        details::hazard_domain::instance().retire(details::existing_hazard_record(), p_retired,
+                                                  p, &destroy_now<T>);
+    }
+
+private:
+    template<typename T>
+    static void destroy_now(const void* p) { TDestroyPolicy::destroy(static_cast<const T*>(p)); }
+};
+
+/* Destroys the objects retired by the current thread that are not protected.
+ * Is called automatically every 64 retired objects. */
+inline void collect_hazard()
+{
+    details::hazard_record* p_record = details::current_hazard_record();
+    if (p_record != NULL) {
+        details::hazard_domain::instance().reserve_hazards(p_record);
+    }
+    details::hazard_domain::instance().scan(p_record);
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_HAZARD_POINTER_H */
@@ -0,0 +1,136 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_IMMORTAL_COUNTER_H
+#define _INTRUSIVE_IMMORTAL_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+
+/*
+ * Atomic counter with the immortal objects.
+ *
+ * The highest bit of the counter marks the immortal object. The counter of
+ * the immortal object is only read, so the shared singletons (the empty
+ * string, the default config) stay in the shared cache lines of all threads
+ * and are never destroyed. The object is created immortal before it becomes
+ * visible to the other threads:
+ *
+ * static const wstux::intrusive_ptr<config> default_config =
+ *     wstux::make_immortal_intrusive<config>();
+ */
+template<typename TValue = size_t>
+struct immortal_counter_policy
+{
+    static_assert(std::is_integral<TValue>::value && std::is_unsigned<TValue>::value,
+                  "counter value must be unsigned integral");
+
+    typedef TValue value_type;
+    typedef std::atomic<TValue> counter_type;
+
+    static constexpr value_type kImmortal = value_type(1) << (sizeof(TValue) * 8 - 1);
+
+    static value_type load(const counter_type& c)
+    {
+        return (c.load(std::memory_order_relaxed) & ~kImmortal);
+    }
+
+    static bool is_immortal(const counter_type& c)
+    {
+        return ((c.load(std::memory_order_relaxed) & kImmortal) != 0);
+    }
+
+    static void increment(counter_type& c) { increment(c, 1); }
+
+    static void increment(counter_type& c, value_type n)
+    {
+        if (! is_immortal(c)) {
+            c.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    /* The immortal object never dies. */
+    static bool try_increment(counter_type& c)
+    {
+        value_type value = c.load(std::memory_order_relaxed);
+        while ((value & kImmortal) == 0) {
+            if (value == 0) {
+                return false;
+            }
+            if (c.compare_exchange_weak(value, value + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return true;
+    }
+
+    static bool decrement(counter_type& c) { return decrement(c, 1); }
+
+    /* The counter that has become immortal between the check and the
+     * decrement keeps the bit, so it never reaches zero. */
+    static bool decrement(counter_type& c, value_type n)
+    {
+        if (is_immortal(c) || c.fetch_sub(n, std::memory_order_release) != n) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    /* The immortal object is shared by everyone. */
+    static bool is_unique(const counter_type& c) { return (c.load(std::memory_order_relaxed) == 1); }
+
+    static void make_immortal(counter_type& c) { c.fetch_or(kImmortal, std::memory_order_relaxed); }
+};
+
+/* Makes the object immortal. The object is never destroyed by the intrusive
+ * pointers, the references taken before are released without the
+ * destruction. Must be called before the object is shared with the other
+ * threads, their releases may race the marking otherwise. */
+template<typename T>
+inline void make_immortal(T* p) { intrusive_ptr_make_immortal(p); }
+
+template<typename T>
+inline void make_immortal(const intrusive_ptr<T>& ptr) { intrusive_ptr_make_immortal(ptr.get()); }
+
+/* Creates the immortal object. Nobody else can see the object while it is
+ * being marked. */
+template<typename T, typename... TArgs>
+inline intrusive_ptr<T> make_immortal_intrusive(TArgs&&... args)
+{
+    intrusive_ptr<T> ptr = make_intrusive<T>(std::forward<TArgs>(args)...);
+    make_immortal(ptr);
+    return ptr;
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_IMMORTAL_COUNTER_H */
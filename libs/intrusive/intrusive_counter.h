@@ -0,0 +1,586 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_INTRUSIVE_COUNTER_H
+#define _INTRUSIVE_INTRUSIVE_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#ifdef INTRUSIVE_CHECK_BORROWS
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+#endif
+
+namespace wstux {
+namespace details {
+
+struct intrusive_access;
+
+#ifdef INTRUSIVE_CHECK_BORROWS
+/* Count of the borrowed pointers of every object. Is used only if
+ * INTRUSIVE_CHECK_BORROWS is defined for the whole program. */
+class borrow_registry
+{
+public:
+    static borrow_registry& instance()
+    {
+        static borrow_registry registry;
+        return registry;
+    }
+
+    void add(const void* p)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_counts[p];
+    }
+
+    void remove(const void* p)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<const void*, size_t>::iterator it = m_counts.find(p);
+        assert(it != m_counts.end());
+        if (--it->second == 0) {
+            m_counts.erase(it);
+        }
+    }
+
+    size_t count(const void* p)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<const void*, size_t>::const_iterator it = m_counts.find(p);
+        return (it != m_counts.end()) ? it->second : 0;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::unordered_map<const void*, size_t> m_counts;
+};
+
+template<typename T>
+inline const void* borrow_key(const T* p)
+{
+    if constexpr (std::is_polymorphic<T>::value) {
+        return dynamic_cast<const void*>(p);
+    } else {
+        return p;
+    }
+}
+#endif
+
+/* Destroys the object whose last reference has been released. */
+template<typename TDestroyPolicy, typename T>
+inline void destroy_released(const T* p)
+{
+#ifdef INTRUSIVE_CHECK_BORROWS
+    assert(borrow_registry::instance().count(borrow_key(p)) == 0
+           && "the object is released while it is borrowed");
+#endif
+    TDestroyPolicy::destroy(p);
+}
+
+template<typename TPolicy, typename T>
+inline auto policy_decrement(typename TPolicy::counter_type& c, T* p, int)
+    -> decltype(TPolicy::decrement(c, p))
+{
+    return TPolicy::decrement(c, p);
+}
+
+template<typename TPolicy, typename T>
+inline bool policy_decrement(typename TPolicy::counter_type& c, T* /*p*/, long)
+{
+    return TPolicy::decrement(c);
+}
+
+template<typename TPolicy>
+inline auto policy_increment_n(typename TPolicy::counter_type& c, typename TPolicy::value_type n, int)
+    -> decltype(TPolicy::increment(c, n))
+{
+    TPolicy::increment(c, n);
+}
+
+template<typename TPolicy>
+inline void policy_increment_n(typename TPolicy::counter_type& c, typename TPolicy::value_type n, long)
+{
+    for (; n > 0; --n) {
+        TPolicy::increment(c);
+    }
+}
+
+template<typename TPolicy, typename T>
+inline auto policy_decrement_n(typename TPolicy::counter_type& c, T* /*p*/,
+                               typename TPolicy::value_type n, int)
+    -> decltype(TPolicy::decrement(c, n))
+{
+    return TPolicy::decrement(c, n);
+}
+
+/* Only the last decrement may reach zero. */
+template<typename TPolicy, typename T>
+inline bool policy_decrement_n(typename TPolicy::counter_type& c, T* p,
+                               typename TPolicy::value_type n, long)
+{
+    bool is_zero = false;
+    for (; n > 0; --n) {
+        is_zero = policy_decrement<TPolicy>(c, p, 0);
+    }
+    return is_zero;
+}
+
+/* The batch wider than the counter value is split, so the policy sees every
+ * part and checks its overflow. */
+template<typename TPolicy>
+inline void policy_increment_batch(typename TPolicy::counter_type& c, size_t n)
+{
+    typedef typename TPolicy::value_type value_type;
+    const size_t max = static_cast<size_t>(std::numeric_limits<value_type>::max());
+    for (; n > max; n -= max) {
+        policy_increment_n<TPolicy>(c, static_cast<value_type>(max), 0);
+    }
+    policy_increment_n<TPolicy>(c, static_cast<value_type>(n), 0);
+}
+
+template<typename TPolicy, typename T>
+inline bool policy_decrement_batch(typename TPolicy::counter_type& c, T* p, size_t n)
+{
+    typedef typename TPolicy::value_type value_type;
+    const size_t max = static_cast<size_t>(std::numeric_limits<value_type>::max());
+    for (; n > max; n -= max) {
+        policy_decrement_n<TPolicy>(c, p, static_cast<value_type>(max), 0);
+    }
+    return policy_decrement_n<TPolicy>(c, p, static_cast<value_type>(n), 0);
+}
+
+template<typename TPolicy>
+inline auto policy_is_unique(const typename TPolicy::counter_type& c, int)
+    -> decltype(TPolicy::is_unique(c))
+{
+    return TPolicy::is_unique(c);
+}
+
+template<typename TPolicy>
+inline bool policy_is_unique(const typename TPolicy::counter_type& c, long)
+{
+    return (TPolicy::load(c) == 1);
+}
+
+} // namespace details
+
+/*
+ * Counter policies.
+ *
+ * A policy describes the storage of the reference counter and the operations
+ * on it. Every policy provides:
+ *  - value_type   - integral type of the counter value;
+ *  - counter_type - type of the counter storage;
+ *  - load(c)      - returns the current counter value;
+ *  - increment(c) - increments the counter;
+ *  - decrement(c) - decrements the counter and returns true if the counter
+ *                   has reached zero and the object must be destroyed.
+ *
+ * A policy that may postpone a release provides 'decrement(c, p)' instead. It
+ * gets the released object and may release it later through its own
+ * intrusive_ptr_release() hook.
+ *
+ * A policy may also provide 'increment(c, n)' and 'decrement(c, n)' that add
+ * or remove 'n' references with one operation. Otherwise the batched hooks
+ * repeat the single operations.
+ *
+ * A policy whose 'load(c) == 1' doesn't mean that the caller owns the only
+ * reference provides 'is_unique(c)'.
+ *
+ * 'try_increment(c)' increments the counter unless it has reached zero and
+ * returns false then. It takes a reference of an object found by a lock-free
+ * lookup, whose memory is kept by other means, without resurrecting it.
+ */
+
+/* Non-atomic counter for objects owned by a single thread. */
+template<typename TValue = size_t>
+struct plain_counter_policy
+{
+    static_assert(std::is_integral<TValue>::value, "counter value must be integral");
+
+    typedef TValue value_type;
+    typedef TValue counter_type;
+
+    static value_type load(const counter_type& c) { return c; }
+
+    static void increment(counter_type& c) { ++c; }
+
+    static void increment(counter_type& c, value_type n) { c += n; }
+
+    static bool try_increment(counter_type& c)
+    {
+        if (c == 0) {
+            return false;
+        }
+        ++c;
+        return true;
+    }
+
+    static bool decrement(counter_type& c) { return (--c == 0); }
+
+    static bool decrement(counter_type& c, value_type n) { return ((c -= n) == 0); }
+};
+
+/* Atomic counter with the memory ordering chosen at compile time. */
+template<typename TValue = size_t,
+         std::memory_order TIncOrder = std::memory_order_seq_cst,
+         std::memory_order TDecOrder = std::memory_order_seq_cst>
+struct atomic_counter_policy
+{
+    static_assert(std::is_integral<TValue>::value, "counter value must be integral");
+
+    typedef TValue value_type;
+    typedef std::atomic<TValue> counter_type;
+
+    static value_type load(const counter_type& c) { return c.load(std::memory_order_relaxed); }
+
+    static void increment(counter_type& c) { c.fetch_add(1, TIncOrder); }
+
+    static void increment(counter_type& c, value_type n) { c.fetch_add(n, TIncOrder); }
+
+    static bool try_increment(counter_type& c)
+    {
+        value_type value = c.load(std::memory_order_relaxed);
+        while (value != 0) {
+            if (c.compare_exchange_weak(value, value + 1, TIncOrder, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool decrement(counter_type& c) { return decrement(c, 1); }
+
+    static bool decrement(counter_type& c, value_type n)
+    {
+        if (c.fetch_sub(n, TDecOrder) != n) {
+            return false;
+        }
+        /* The release decrement is not enough for the destroying thread: it
+         * must also see all writes made through the other references. It is
+         * paid only once, when the counter reaches zero. */
+        if (TDecOrder == std::memory_order_release) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return true;
+    }
+};
+
+/* A new reference can only be taken from an existing one, so an increment
+ * does not have to synchronize with anything. The decrement publishes all
+ * writes to the object and the acquire fence is issued only by the thread
+ * that destroys the object. */
+template<typename TValue = size_t>
+using relaxed_atomic_counter_policy = atomic_counter_policy<TValue,
+                                                            std::memory_order_relaxed,
+                                                            std::memory_order_release>;
+
+template<typename TValue = size_t>
+using acq_rel_atomic_counter_policy = atomic_counter_policy<TValue,
+                                                            std::memory_order_acq_rel,
+                                                            std::memory_order_acq_rel>;
+
+/*
+ * Reference counter.
+ *
+ * Copying an object must not copy its reference counter: the new object is
+ * not referenced by anyone yet.
+ */
+template<typename TPolicy>
+class basic_ref_counter
+{
+public:
+    typedef TPolicy policy_type;
+    typedef typename TPolicy::value_type value_type;
+
+    basic_ref_counter()
+        : m_counter(0)
+    {}
+
+    basic_ref_counter(const basic_ref_counter& /*rhs*/)
+        : m_counter(0)
+    {}
+
+    basic_ref_counter& operator=(const basic_ref_counter& /*rhs*/) { return *this; }
+
+    operator value_type() const { return use_count(); }
+
+    value_type use_count() const { return TPolicy::load(m_counter); }
+
+    void add_ref() { TPolicy::increment(m_counter); }
+
+    void add_ref(size_t n) { details::policy_increment_batch<TPolicy>(m_counter, n); }
+
+    /* Is available for policies with 'try_increment' only. */
+    bool try_add_ref() { return TPolicy::try_increment(m_counter); }
+
+    bool release() { return TPolicy::decrement(m_counter); }
+
+    template<typename T>
+    bool release(T* p) { return details::policy_decrement<TPolicy>(m_counter, p, 0); }
+
+    template<typename T>
+    bool release(T* p, size_t n) { return details::policy_decrement_batch<TPolicy>(m_counter, p, n); }
+
+    /* Returns true if the caller owns the only reference. The writes made
+     * through the released references are visible to it then. */
+    bool is_unique() const
+    {
+        if (! details::policy_is_unique<TPolicy>(m_counter, 0)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    /* Is available for policies with the base reference only. */
+    bool retire() { return TPolicy::retire(m_counter); }
+
+    /* Is available for policies with the weak references only. */
+    auto add_weak_ref() { return TPolicy::add_weak_ref(m_counter); }
+
+    /* Is available for policies with the immortal objects only. */
+    void make_immortal() { TPolicy::make_immortal(m_counter); }
+
+private:
+    typename TPolicy::counter_type m_counter;
+};
+
+/* Destroy policy of the objects created by the new expression. */
+struct delete_destroy_policy
+{
+    template<typename T, typename... TArgs>
+    static T* create(TArgs&&... args) { return ::new T(std::forward<TArgs>(args)...); }
+
+    template<typename T>
+    static void destroy(const T* p) { delete p; }
+};
+
+/*
+ * Base class for reference counted objects.
+ *
+ * class foo : public wstux::intrusive_ref_counter<foo, wstux::plain_counter_policy<uint32_t>>
+ * { ... };
+ *
+ * The destroy policy frees the object after its last release and creates the
+ * object in make_intrusive().
+ */
+template<typename TDerived,
+         typename TPolicy = relaxed_atomic_counter_policy<size_t>,
+         typename TDestroyPolicy = delete_destroy_policy>
+class intrusive_ref_counter
+{
+public:
+    typedef typename TPolicy::value_type value_type;
+    typedef TDestroyPolicy intrusive_destroy_policy;
+
+    value_type use_count() const { return m_ref_counter.use_count(); }
+
+protected:
+    intrusive_ref_counter() = default;
+    intrusive_ref_counter(const intrusive_ref_counter&) = default;
+    intrusive_ref_counter& operator=(const intrusive_ref_counter&) = default;
+    ~intrusive_ref_counter() = default;
+
+    friend void intrusive_ptr_add_ref(const intrusive_ref_counter* p)
+    {
+        p->m_ref_counter.add_ref();
+    }
+
+    friend void intrusive_ptr_add_ref(const intrusive_ref_counter* p, size_t n)
+    {
+        p->m_ref_counter.add_ref(n);
+    }
+
+    friend bool intrusive_ptr_try_add_ref(const intrusive_ref_counter* p)
+    {
+        return p->m_ref_counter.try_add_ref();
+    }
+
+    friend void intrusive_ptr_release(const intrusive_ref_counter* p)
+    {
+        if (p->m_ref_counter.release(p)) {
+            details::destroy_released<TDestroyPolicy>(static_cast<const TDerived*>(p));
+        }
+    }
+
+    friend void intrusive_ptr_release(const intrusive_ref_counter* p, size_t n)
+    {
+        if (p->m_ref_counter.release(p, n)) {
+            details::destroy_released<TDestroyPolicy>(static_cast<const TDerived*>(p));
+        }
+    }
+
+    friend bool intrusive_ptr_is_unique(const intrusive_ref_counter* p)
+    {
+        return p->m_ref_counter.is_unique();
+    }
+
+    friend void intrusive_ptr_retire(const intrusive_ref_counter* p)
+    {
+        if (p->m_ref_counter.retire()) {
+            details::destroy_released<TDestroyPolicy>(static_cast<const TDerived*>(p));
+        }
+    }
+
+    friend auto intrusive_ptr_add_weak_ref(const intrusive_ref_counter* p)
+    {
+        return p->m_ref_counter.add_weak_ref();
+    }
+
+    friend void intrusive_ptr_make_immortal(const intrusive_ref_counter* p)
+    {
+        p->m_ref_counter.make_immortal();
+    }
+
+private:
+    mutable basic_ref_counter<TPolicy> m_ref_counter;
+};
+
+} // namespace wstux
+
+/*
+ * Macros for declaring of the reference counter inside of a class.
+ *
+ * class foo
+ * {
+ *     INIT_ATOMIC_INTRUSIVE_PTR;
+ * public:
+ *     ...
+ * };
+ *
+ * The intrusive_ptr_retire() hook is generated for policies with the base
+ * reference only, the intrusive_ptr_add_weak_ref() hook is generated for
+ * policies with the weak references only, the intrusive_ptr_make_immortal()
+ * hook is generated for policies with the immortal objects only.
+ *
+ * INIT_INTRUSIVE_PTR_WITH_DESTROY_POLICY(destroy_policy, counter_policy) sets
+ * the destroy policy of the class as well.
+ *
+ * The hooks are hidden friend templates. They are restricted to the classes
+ * that share the same '__intrusive_tag', so the hooks of the different
+ * classes do not conflict and derived classes use the hooks of the base.
+ */
+#define INIT_INTRUSIVE_PTR_WITH_DESTROY_POLICY(destroy_policy, ...)             \
+    struct __intrusive_tag {};                                                  \
+    typedef destroy_policy intrusive_destroy_policy;                            \
+    friend struct ::wstux::details::intrusive_access;                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend void intrusive_ptr_add_ref(__T* p)                                   \
+    {                                                                           \
+        p->m_ref_counter.add_ref();                                             \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend void intrusive_ptr_add_ref(__T* p, size_t n)                         \
+    {                                                                           \
+        p->m_ref_counter.add_ref(n);                                            \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend bool intrusive_ptr_try_add_ref(__T* p)                               \
+    {                                                                           \
+        return p->m_ref_counter.try_add_ref();                                  \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend void intrusive_ptr_release(__T* p)                                   \
+    {                                                                           \
+        if (p->m_ref_counter.release(p)) {                                      \
+            ::wstux::details::destroy_released<destroy_policy>(p);              \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend void intrusive_ptr_release(__T* p, size_t n)                         \
+    {                                                                           \
+        if (p->m_ref_counter.release(p, n)) {                                   \
+            ::wstux::details::destroy_released<destroy_policy>(p);              \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend bool intrusive_ptr_is_unique(__T* p)                                 \
+    {                                                                           \
+        return p->m_ref_counter.is_unique();                                    \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend void intrusive_ptr_retire(__T* p)                                    \
+    {                                                                           \
+        if (p->m_ref_counter.retire()) {                                        \
+            ::wstux::details::destroy_released<destroy_policy>(p);              \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend auto intrusive_ptr_add_weak_ref(__T* p)                              \
+    {                                                                           \
+        return p->m_ref_counter.add_weak_ref();                                 \
+    }                                                                           \
+                                                                                \
+    template<typename __T, typename std::enable_if<                             \
+        std::is_same<typename __T::__intrusive_tag, __intrusive_tag>::value,    \
+        int>::type = 0>                                                         \
+    friend void intrusive_ptr_make_immortal(__T* p)                             \
+    {                                                                           \
+        p->m_ref_counter.make_immortal();                                       \
+    }                                                                           \
+                                                                                \
+    mutable ::wstux::basic_ref_counter<__VA_ARGS__> m_ref_counter
+
+#define INIT_INTRUSIVE_PTR_WITH_POLICY(...)                                     \
+    INIT_INTRUSIVE_PTR_WITH_DESTROY_POLICY(::wstux::delete_destroy_policy,     \
+                                           __VA_ARGS__)
+
+#define INIT_INTRUSIVE_PTR                                                      \
+    INIT_INTRUSIVE_PTR_WITH_POLICY(::wstux::plain_counter_policy<size_t>)
+
+#define INIT_ATOMIC_INTRUSIVE_PTR                                               \
+    INIT_INTRUSIVE_PTR_WITH_POLICY(::wstux::relaxed_atomic_counter_policy<size_t>)
+
+#endif /* _INTRUSIVE_INTRUSIVE_COUNTER_H */
@@ -0,0 +1,241 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_INTRUSIVE_HASH_SET_H
+#define _INTRUSIVE_INTRUSIVE_HASH_SET_H
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+
+/*
+ * Link of an object in an intrusive_hash_set. The hash of the key is cached
+ * in the link, so the chain is scanned and the set is rehashed without
+ * touching the keys.
+ */
+template<typename TTag = void>
+struct set_hook
+{
+    set_hook() noexcept
+        : p_next(NULL)
+        , hash(0)
+        , is_linked(false)
+    {}
+
+    /* The link belongs to the set, not to the value of the object. */
+    set_hook(const set_hook&) noexcept
+        : p_next(NULL)
+        , hash(0)
+        , is_linked(false)
+    {}
+
+    set_hook& operator=(const set_hook&) noexcept { return *this; }
+
+    set_hook* p_next;
+    size_t hash;
+    bool is_linked;
+};
+
+/* Returns the member 'key' of the object. */
+struct member_key
+{
+    template<typename T>
+    auto operator()(const T& value) const noexcept -> decltype((value.key)) { return value.key; }
+};
+
+/*
+ * Hash set of the objects that hold their links (open hashing).
+ *
+ * struct connection : public wstux::intrusive_ref_counter<connection>
+ *                   , public wstux::set_hook<>
+ * {
+ *     uint64_t key;
+ * };
+ * wstux::intrusive_hash_set<connection, uint64_t> table(1024);
+ *
+ * The set holds a reference of every object. The buckets are allocated by
+ * the constructor and by rehash() only, inserting and removing never
+ * allocate, so the set is not rehashed automatically: the owner calls
+ * rehash() when load_factor() grows too high.
+ */
+template<typename T,
+         typename TKey,
+         typename TKeyOf = member_key,
+         typename THash = std::hash<TKey>,
+         typename TEqual = std::equal_to<TKey>,
+         typename TTag = void>
+class intrusive_hash_set
+{
+    typedef set_hook<TTag> __hook_type;
+
+public:
+    typedef intrusive_ptr<T> value_type;
+    typedef TKey key_type;
+
+    explicit intrusive_hash_set(size_t bucket_count = 64)
+        : m_bucket_count(round_up(bucket_count))
+        , m_buckets(new __hook_type*[m_bucket_count]())
+        , m_size(0)
+    {}
+
+    intrusive_hash_set(const intrusive_hash_set&) = delete;
+    intrusive_hash_set& operator=(const intrusive_hash_set&) = delete;
+
+    ~intrusive_hash_set() noexcept { clear(); }
+
+    bool empty() const noexcept { return (m_size == 0); }
+
+    size_t size() const noexcept { return m_size; }
+
+    size_t bucket_count() const noexcept { return m_bucket_count; }
+
+    float load_factor() const noexcept { return static_cast<float>(m_size) / m_bucket_count; }
+
+    /* Inserts the object if no object with the same key is in the set. */
+    bool insert(value_type ptr)
+    {
+        assert(ptr);
+        __hook_type* p_hook = static_cast<__hook_type*>(ptr.get());
+        assert(! p_hook->is_linked);
+        const key_type& key = TKeyOf()(*ptr);
+        const size_t hash = THash()(key);
+        if (find(key, hash) != NULL) {
+            return false;
+        }
+        __hook_type*& p_bucket = m_buckets[hash & (m_bucket_count - 1)];
+        p_hook->hash = hash;
+        p_hook->is_linked = true;
+        p_hook->p_next = p_bucket;
+        p_bucket = p_hook;
+        ptr.detach();
+        ++m_size;
+        return true;
+    }
+
+    /* Returns the object without a reference, it is valid while the object
+     * is in the set. */
+    T* find(const key_type& key) const { return find(key, THash()(key)); }
+
+    bool contains(const key_type& key) const { return (find(key) != NULL); }
+
+    /* Removes the object and returns the reference held by the set. */
+    value_type erase(const key_type& key)
+    {
+        const size_t hash = THash()(key);
+        for (__hook_type** pp_hook = &m_buckets[hash & (m_bucket_count - 1)];
+             *pp_hook != NULL; pp_hook = &(*pp_hook)->p_next) {
+            T* p = static_cast<T*>(*pp_hook);
+            if ((*pp_hook)->hash == hash && TEqual()(TKeyOf()(*p), key)) {
+                return unlink(pp_hook);
+            }
+        }
+        return value_type();
+    }
+
+    /* Calls 'func' for every object. */
+    template<typename TFunc>
+    void for_each(TFunc func) const
+    {
+        for (size_t i = 0; i < m_bucket_count; ++i) {
+            for (__hook_type* p_hook = m_buckets[i]; p_hook != NULL; p_hook = p_hook->p_next) {
+                func(*static_cast<T*>(p_hook));
+            }
+        }
+    }
+
+    void clear() noexcept
+    {
+        for (size_t i = 0; i < m_bucket_count; ++i) {
+            while (m_buckets[i] != NULL) {
+                unlink(&m_buckets[i]);
+            }
+        }
+    }
+
+    /* Moves the objects to 'bucket_count' buckets, rounded up to a power of
+     * two. The cached hashes are used. */
+    void rehash(size_t bucket_count)
+    {
+        const size_t new_count = round_up(bucket_count);
+        std::unique_ptr<__hook_type*[]> buckets(new __hook_type*[new_count]());
+        for (size_t i = 0; i < m_bucket_count; ++i) {
+            __hook_type* p_hook = m_buckets[i];
+            while (p_hook != NULL) {
+                __hook_type* p_next = p_hook->p_next;
+                __hook_type*& p_bucket = buckets[p_hook->hash & (new_count - 1)];
+                p_hook->p_next = p_bucket;
+                p_bucket = p_hook;
+                p_hook = p_next;
+            }
+        }
+        m_buckets.swap(buckets);
+        m_bucket_count = new_count;
+    }
+
+private:
+    T* find(const key_type& key, size_t hash) const
+    {
+        for (__hook_type* p_hook = m_buckets[hash & (m_bucket_count - 1)];
+             p_hook != NULL; p_hook = p_hook->p_next) {
+            T* p = static_cast<T*>(p_hook);
+            if (p_hook->hash == hash && TEqual()(TKeyOf()(*p), key)) {
+                return p;
+            }
+        }
+        return NULL;
+    }
+
+    value_type unlink(__hook_type** pp_hook) noexcept
+    {
+        __hook_type* p_hook = *pp_hook;
+        *pp_hook = p_hook->p_next;
+        p_hook->p_next = NULL;
+        p_hook->is_linked = false;
+        --m_size;
+        return value_type(static_cast<T*>(p_hook), false);
+    }
+
+    static size_t round_up(size_t count)
+    {
+        size_t result = 1;
+        while (result < count) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+private:
+    size_t m_bucket_count;
+    std::unique_ptr<__hook_type*[]> m_buckets;
+    size_t m_size;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_INTRUSIVE_HASH_SET_H */
@@ -0,0 +1,248 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_INTRUSIVE_LIST_H
+#define _INTRUSIVE_INTRUSIVE_LIST_H
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+
+/*
+ * Link of an object in an intrusive_list.
+ *
+ * class connection : public wstux::intrusive_ref_counter<connection>
+ *                  , public wstux::list_hook<>
+ * { ... };
+ *
+ * The tag tells the hooks of the different lists apart.
+ */
+template<typename TTag = void>
+struct list_hook
+{
+    list_hook() noexcept
+        : p_prev(NULL)
+        , p_next(NULL)
+    {}
+
+    /* The link belongs to the list, not to the value of the object. */
+    list_hook(const list_hook&) noexcept
+        : p_prev(NULL)
+        , p_next(NULL)
+    {}
+
+    list_hook& operator=(const list_hook&) noexcept { return *this; }
+
+    bool is_linked() const noexcept { return (p_next != NULL); }
+
+    list_hook* p_prev;
+    list_hook* p_next;
+};
+
+/*
+ * Doubly linked list of the objects that hold their links.
+ *
+ * The list holds a reference of every object, inserting and removing never
+ * allocate and the objects are reached without a separate node. An object
+ * may be removed or moved by the raw pointer, e.g. found in a hash set, which
+ * makes an LRU list:
+ *
+ * lru.move_to_front(p_conn);
+ * wstux::intrusive_ptr<connection> victim = lru.pop_back();
+ */
+template<typename T, typename TTag = void>
+class intrusive_list
+{
+    typedef list_hook<TTag> __hook_type;
+
+    template<typename TValue, typename THook>
+    class basic_iterator
+    {
+        friend class intrusive_list;
+
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef TValue value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef TValue* pointer;
+        typedef TValue& reference;
+
+        basic_iterator() noexcept
+            : m_p_hook(NULL)
+        {}
+
+        reference operator*() const noexcept { return *to_value(m_p_hook); }
+
+        pointer operator->() const noexcept { return to_value(m_p_hook); }
+
+        basic_iterator& operator++() noexcept { m_p_hook = m_p_hook->p_next; return *this; }
+
+        basic_iterator operator++(int) noexcept { basic_iterator tmp(*this); ++*this; return tmp; }
+
+        basic_iterator& operator--() noexcept { m_p_hook = m_p_hook->p_prev; return *this; }
+
+        basic_iterator operator--(int) noexcept { basic_iterator tmp(*this); --*this; return tmp; }
+
+        bool operator==(const basic_iterator& rhs) const noexcept { return m_p_hook == rhs.m_p_hook; }
+
+        bool operator!=(const basic_iterator& rhs) const noexcept { return m_p_hook != rhs.m_p_hook; }
+
+    private:
+        explicit basic_iterator(THook* p_hook) noexcept
+            : m_p_hook(p_hook)
+        {}
+
+        static pointer to_value(THook* p_hook) noexcept { return static_cast<pointer>(p_hook); }
+
+    private:
+        THook* m_p_hook;
+    };
+
+public:
+    typedef intrusive_ptr<T> value_type;
+    typedef basic_iterator<T, __hook_type> iterator;
+    typedef basic_iterator<const T, const __hook_type> const_iterator;
+
+    intrusive_list() noexcept
+        : m_size(0)
+    {
+        m_root.p_prev = &m_root;
+        m_root.p_next = &m_root;
+    }
+
+    intrusive_list(const intrusive_list&) = delete;
+    intrusive_list& operator=(const intrusive_list&) = delete;
+
+    ~intrusive_list() noexcept { clear(); }
+
+    iterator begin() noexcept { return iterator(m_root.p_next); }
+
+    iterator end() noexcept { return iterator(&m_root); }
+
+    const_iterator begin() const noexcept { return const_iterator(m_root.p_next); }
+
+    const_iterator end() const noexcept { return const_iterator(&m_root); }
+
+    bool empty() const noexcept { return (m_size == 0); }
+
+    size_t size() const noexcept { return m_size; }
+
+    T* front() const noexcept { assert(! empty()); return static_cast<T*>(m_root.p_next); }
+
+    T* back() const noexcept { assert(! empty()); return static_cast<T*>(m_root.p_prev); }
+
+    void push_front(value_type ptr) noexcept
+    {
+        assert(ptr);
+        link_before(m_root.p_next, ptr.detach());
+    }
+
+    void push_back(value_type ptr) noexcept
+    {
+        assert(ptr);
+        link_before(&m_root, ptr.detach());
+    }
+
+    /* Inserts the object before 'pos' and returns the iterator to it. */
+    iterator insert(iterator pos, value_type ptr) noexcept
+    {
+        assert(ptr);
+        T* p = ptr.detach();
+        link_before(pos.m_p_hook, p);
+        return iterator(static_cast<__hook_type*>(p));
+    }
+
+    value_type pop_front() noexcept { return empty() ? value_type() : erase(front()); }
+
+    value_type pop_back() noexcept { return empty() ? value_type() : erase(back()); }
+
+    /* Removes the linked object and returns the reference held by the list. */
+    value_type erase(T* p) noexcept
+    {
+        __hook_type* p_hook = static_cast<__hook_type*>(p);
+        assert(p_hook->is_linked());
+        unlink(p_hook);
+        return value_type(p, false);
+    }
+
+    /* Returns the iterator following the removed object. */
+    iterator erase(iterator pos) noexcept
+    {
+        iterator next(pos.m_p_hook->p_next);
+        erase(&*pos);
+        return next;
+    }
+
+    /* Moves the linked object to the front without touching its counter. */
+    void move_to_front(T* p) noexcept
+    {
+        __hook_type* p_hook = static_cast<__hook_type*>(p);
+        assert(p_hook->is_linked());
+        unlink(p_hook);
+        link_before(m_root.p_next, p);
+    }
+
+    void clear() noexcept
+    {
+        while (! empty()) {
+            pop_front();
+        }
+    }
+
+    /* Returns the iterator to the linked object. */
+    static iterator iterator_to(T* p) noexcept { return iterator(static_cast<__hook_type*>(p)); }
+
+private:
+    void link_before(__hook_type* p_pos, T* p) noexcept
+    {
+        __hook_type* p_hook = static_cast<__hook_type*>(p);
+        assert(! p_hook->is_linked());
+        p_hook->p_next = p_pos;
+        p_hook->p_prev = p_pos->p_prev;
+        p_pos->p_prev->p_next = p_hook;
+        p_pos->p_prev = p_hook;
+        ++m_size;
+    }
+
+    void unlink(__hook_type* p_hook) noexcept
+    {
+        p_hook->p_prev->p_next = p_hook->p_next;
+        p_hook->p_next->p_prev = p_hook->p_prev;
+        p_hook->p_prev = NULL;
+        p_hook->p_next = NULL;
+        --m_size;
+    }
+
+private:
+    __hook_type m_root;
+    size_t m_size;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_INTRUSIVE_LIST_H */
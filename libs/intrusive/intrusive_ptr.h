@@ -30,6 +30,9 @@
 #include <functional>
 #include <memory>
 #include <type_traits>
+#include <utility>
+
+#include "intrusive/relocate.h"
 
 namespace wstux {
 namespace details {
@@ -40,29 +43,93 @@ struct __enable_if_convertible
     typedef typename std::enable_if<std::is_convertible<From, To>::value>::type type;
 };
 
+/* Access to the destroy policy, that may be declared privately by the
+ * INIT_INTRUSIVE_PTR_* macros. */
+struct intrusive_access
+{
+    template<typename T>
+    struct destroy_policy
+    {
+        typedef typename T::intrusive_destroy_policy type;
+    };
+
+    /* The policy is looked up in the immediate context, so the classes with
+     * their own hooks and without the policy fall back to 'new'. */
+    template<typename T, typename... TArgs>
+    static auto create(int, TArgs&&... args)
+        -> decltype(T::intrusive_destroy_policy::template create<T>(std::forward<TArgs>(args)...))
+    {
+        return T::intrusive_destroy_policy::template create<T>(std::forward<TArgs>(args)...);
+    }
+
+    template<typename T, typename... TArgs>
+    static T* create(long, TArgs&&... args) { return ::new T(std::forward<TArgs>(args)...); }
+};
+
+/* Adds 'n' references with the batched hook if the class provides it and
+ * with 'n' single hooks otherwise. */
+template<typename T>
+inline auto add_ref_n(T* p, size_t n, int) -> decltype(intrusive_ptr_add_ref(p, n))
+{
+    intrusive_ptr_add_ref(p, n);
+}
+
+template<typename T>
+inline void add_ref_n(T* p, size_t n, long)
+{
+    for (; n > 0; --n) {
+        intrusive_ptr_add_ref(p);
+    }
+}
+
+template<typename T>
+inline void add_ref_n(T* p, size_t n) { add_ref_n(p, n, 0); }
+
+template<typename T>
+inline auto release_n(T* p, size_t n, int) -> decltype(intrusive_ptr_release(p, n))
+{
+    intrusive_ptr_release(p, n);
+}
+
+template<typename T>
+inline void release_n(T* p, size_t n, long)
+{
+    for (; n > 0; --n) {
+        intrusive_ptr_release(p);
+    }
+}
+
+template<typename T>
+inline void release_n(T* p, size_t n) { release_n(p, n, 0); }
+
 } // namespace details
 
 template<typename T>
-class intrusive_ptr
+class intrusive_ptr INTRUSIVE_TRIVIALLY_RELOCATABLE
 {
     typedef T* __ptr_type;
 
+    template<typename U>
+    friend class intrusive_ptr;
+
 public:
     typedef T element_type;
 
-    intrusive_ptr()
+    intrusive_ptr() noexcept
         : m_ptr(NULL)
     {}
 
-    intrusive_ptr(element_type* ptr)
+    /* If 'add_ref' is false, the pointer adopts the reference that the caller
+     * already owns, e.g. the one given up by detach(). */
+    intrusive_ptr(element_type* ptr, bool add_ref = true) noexcept
         : m_ptr(ptr)
     {
-        if (m_ptr != NULL) {
+        if (m_ptr != NULL && add_ref) {
             intrusive_ptr_add_ref(m_ptr);
         }
     }
 
-    intrusive_ptr(const intrusive_ptr& rhs)
+    intrusive_ptr(const intrusive_ptr& rhs) noexcept
         : m_ptr(rhs.m_ptr)
     {
         if (m_ptr != NULL) {
@@ -72,7 +139,7 @@ public:
 
     //template<typename U, typename = typename details::__enable_if_convertible<U, T>::type>
     template<typename U>
-    intrusive_ptr(const intrusive_ptr<U>& rhs)//, typename details::__enable_if_convertible<U, T>::type* = 0)
+    intrusive_ptr(const intrusive_ptr<U>& rhs) noexcept//, typename details::__enable_if_convertible<U, T>::type* = 0)
         : m_ptr(rhs.get())
     {
         if (m_ptr != NULL) {
@@ -80,7 +147,7 @@ public:
         }
     }
 
-    intrusive_ptr(intrusive_ptr&& rhs)
+    intrusive_ptr(intrusive_ptr&& rhs) noexcept
         : m_ptr(rhs.m_ptr)
     {
         rhs.m_ptr = NULL;
@@ -88,20 +155,20 @@ public:
 
     //template<class U, typename = typename details::__enable_if_convertible<U, T>::type>
     template<class U>
-    intrusive_ptr(intrusive_ptr<U>&& rhs)//, typename details::__enable_if_convertible<U, T>::type* = 0)
+    intrusive_ptr(intrusive_ptr<U>&& rhs) noexcept//, typename details::__enable_if_convertible<U, T>::type* = 0)
         : m_ptr(rhs.m_ptr)
     {
         rhs.m_ptr = NULL;
     }
 
-    ~intrusive_ptr()
+    ~intrusive_ptr() noexcept
     {
         if (m_ptr != NULL) {
             intrusive_ptr_release(m_ptr);
         }
     }
 
-    intrusive_ptr& operator=(const intrusive_ptr& rhs)
+    intrusive_ptr& operator=(const intrusive_ptr& rhs) noexcept
     {
         intrusive_ptr(rhs).swap(*this);
         return *this;
@@ -109,13 +176,13 @@ public:
 
     //template<typename U, typename = typename details::__enable_if_convertible<U, T>::type>
     template<class U>
-    intrusive_ptr& operator=(const intrusive_ptr<U>& rhs)
+    intrusive_ptr& operator=(const intrusive_ptr<U>& rhs) noexcept
     {
         intrusive_ptr(rhs).swap(*this);
         return *this;
     }
 
-    intrusive_ptr& operator=(intrusive_ptr&& rhs)
+    intrusive_ptr& operator=(intrusive_ptr&& rhs) noexcept
     {
         intrusive_ptr(static_cast<intrusive_ptr&&>(rhs)).swap(*this);
         return *this;
@@ -123,75 +190,103 @@ public:
 
     //template<typename U, typename = typename details::__enable_if_convertible<U, T>::type>
     template<class U>
-    intrusive_ptr& operator=(intrusive_ptr<U>&& rhs)
+    intrusive_ptr& operator=(intrusive_ptr<U>&& rhs) noexcept
     {
         intrusive_ptr(static_cast<intrusive_ptr<U>&&>(rhs)).swap(*this);
         return *this;
     }
 
-    intrusive_ptr& operator=(element_type* rhs)
+    intrusive_ptr& operator=(element_type* rhs) noexcept
     {
         intrusive_ptr(rhs).swap(*this);
         return *this;
     }
 
-    element_type& operator*() const { assert(m_ptr != NULL); return *m_ptr; }
+    element_type& operator*() const noexcept { assert(m_ptr != NULL); return *m_ptr; }
 
-    element_type* operator->() const { assert(m_ptr != NULL); return m_ptr; }
+    element_type* operator->() const noexcept { assert(m_ptr != NULL); return m_ptr; }
 
-    bool operator!() const { return (m_ptr == NULL); }
+    bool operator!() const noexcept { return (m_ptr == NULL); }
 
-    explicit operator bool () const { return (m_ptr != NULL); }
+    explicit operator bool () const noexcept { return (m_ptr != NULL); }
 
-    element_type* get() const { return m_ptr; }
+    element_type* get() const noexcept { return m_ptr; }
 
-    void swap(intrusive_ptr& rhs)
+    /* Gives up the reference without releasing it. The caller becomes its
+     * owner and passes it back with intrusive_ptr(p, false). */
+    element_type* detach() noexcept
+    {
+        __ptr_type p = m_ptr;
+        m_ptr = NULL;
+        return p;
+    }
+
+    void swap(intrusive_ptr& rhs) noexcept
     {
         __ptr_type p_tmp = m_ptr;
         m_ptr = rhs.m_ptr;
         rhs.m_ptr = p_tmp;
     }
 
-    void reset() { intrusive_ptr().swap(*this); }
+    void reset() noexcept { intrusive_ptr().swap(*this); }
+
+    void reset(element_type* rhs) noexcept { intrusive_ptr(rhs).swap(*this); }
+
+    void reset(element_type* rhs, bool add_ref) noexcept { intrusive_ptr(rhs, add_ref).swap(*this); }
 
-    void reset(element_type* rhs) { intrusive_ptr(rhs).swap(*this); }
+    /* Takes a reference of the object unless its counter has already reached
+     * zero and returns the empty pointer then. The memory of the object must
+     * be kept by the caller, e.g. by an epoch_guard or a hazard_pointer. The
+     * object must provide the intrusive_ptr_try_add_ref() hook. */
+    static intrusive_ptr try_acquire(element_type* ptr) noexcept
+    {
+        if (ptr == NULL || ! intrusive_ptr_try_add_ref(ptr)) {
+            return intrusive_ptr();
+        }
+        return intrusive_ptr(ptr, false);
+    }
 
 private:
     __ptr_type m_ptr;
 };
 
+/* The pointer holds no address of itself, so it is moved with memcpy. */
+template<typename T>
+struct is_trivially_relocatable<intrusive_ptr<T>> : std::true_type
+{};
+
 template<typename T, typename U>
-inline bool operator==(const intrusive_ptr<T>& lhs, const intrusive_ptr<U>& rhs)
+inline bool operator==(const intrusive_ptr<T>& lhs, const intrusive_ptr<U>& rhs) noexcept
 {
     return lhs.get() == rhs.get();
 }
 
 template<typename T, typename U>
-inline bool operator!=(const intrusive_ptr<T>& lhs, const intrusive_ptr<U>& rhs)
+inline bool operator!=(const intrusive_ptr<T>& lhs, const intrusive_ptr<U>& rhs) noexcept
 {
     return lhs.get() != rhs.get();
 }
 
 template<typename T, typename U>
-inline bool operator==(const intrusive_ptr<T>& lhs, const U* rhs)
+inline bool operator==(const intrusive_ptr<T>& lhs, const U* rhs) noexcept
 {
     return lhs.get() == rhs;
 }
 
 template<typename T, typename U>
-inline bool operator!=(const intrusive_ptr<T>& lhs, const U* rhs)
+inline bool operator!=(const intrusive_ptr<T>& lhs, const U* rhs) noexcept
 {
     return lhs.get() != rhs;
 }
 
 template<typename T, typename U>
-inline bool operator==(const T* lhs, const intrusive_ptr<U>& rhs)
+inline bool operator==(const T* lhs, const intrusive_ptr<U>& rhs) noexcept
 {
     return lhs == rhs.get();
 }
 
 template<typename T, typename U>
-inline bool operator!=(const T* lhs, const intrusive_ptr<U>& rhs)
+inline bool operator!=(const T* lhs, const intrusive_ptr<U>& rhs) noexcept
 {
     return lhs != rhs.get();
 }
@@ -202,7 +297,7 @@ inline intrusive_ptr<T> make_intrusive(TArgs&&... args)
     typedef typename std::remove_const<T>::type T_nc;
 
     try {
-        return intrusive_ptr<T>(::new T_nc(std::forward<TArgs>(args)...));
+        return intrusive_ptr<T>(details::intrusive_access::create<T_nc>(0, std::forward<TArgs>(args)...));
     } catch (...) {
         throw;
     }
@@ -218,14 +313,14 @@ struct hash<::wstux::intrusive_ptr<T>>;
 template<typename T>
 struct hash<::wstux::intrusive_ptr<T>>
 {
-    size_t operator()(const ::wstux::intrusive_ptr<T>& ptr) const
+    size_t operator()(const ::wstux::intrusive_ptr<T>& ptr) const noexcept
     {
         return ::std::hash<T*>()(ptr.get());
     }
 };
 
 template<typename T>
-void swap(::wstux::intrusive_ptr<T>& lhs, ::wstux::intrusive_ptr<T>& rhs)
+void swap(::wstux::intrusive_ptr<T>& lhs, ::wstux::intrusive_ptr<T>& rhs) noexcept
 {
     lhs.swap(rhs);
 }
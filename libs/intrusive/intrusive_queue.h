@@ -0,0 +1,345 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_INTRUSIVE_QUEUE_H
+#define _INTRUSIVE_INTRUSIVE_QUEUE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "intrusive/atomic_intrusive_ptr.h"
+#include "intrusive/epoch.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+
+/*
+ * Link of an object in a lock-free queue or stack.
+ *
+ * class message : public wstux::intrusive_ref_counter<message>
+ *               , public wstux::queue_hook<>
+ * { ... };
+ *
+ * An object is linked into one container at a time for every hook it has,
+ * the tag tells the hooks of the different containers apart.
+ */
+template<typename TTag = void>
+struct queue_hook
+{
+    queue_hook() noexcept
+        : p_next(NULL)
+    {}
+
+    /* The link belongs to the container, not to the value of the object. */
+    queue_hook(const queue_hook&) noexcept
+        : p_next(NULL)
+    {}
+
+    queue_hook& operator=(const queue_hook&) noexcept { return *this; }
+
+    std::atomic<queue_hook*> p_next;
+};
+
+/*
+ * Multiple producers single consumer queue (Vyukov).
+ *
+ * The link lives in the object, so push() doesn't allocate and the reference
+ * of the pushed pointer is moved into the queue without touching the counter.
+ * pop() gives the reference back. push() is wait-free, pop() may be called by
+ * one thread at a time and returns the empty pointer while the queue is empty
+ * or while the producer that has pushed the next object has not linked it yet.
+ */
+template<typename T, typename TTag = void>
+class mpsc_queue
+{
+    typedef queue_hook<TTag> __hook_type;
+
+public:
+    typedef intrusive_ptr<T> value_type;
+
+    mpsc_queue()
+        : m_p_head(&m_stub)
+        , m_p_tail(&m_stub)
+    {}
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    ~mpsc_queue()
+    {
+        while (pop()) {
+        }
+    }
+
+    void push(value_type&& ptr)
+    {
+        assert(ptr);
+        link(static_cast<__hook_type*>(ptr.detach()));
+    }
+
+    value_type pop()
+    {
+        __hook_type* p_tail = m_p_tail;
+        __hook_type* p_next = p_tail->p_next.load(std::memory_order_acquire);
+        if (p_tail == &m_stub) {
+            if (p_next == NULL) {
+                return value_type();
+            }
+            m_p_tail = p_next;
+            p_tail = p_next;
+            p_next = p_next->p_next.load(std::memory_order_acquire);
+        }
+        if (p_next != NULL) {
+            m_p_tail = p_next;
+            return adopt(p_tail);
+        }
+        if (p_tail != m_p_head.load(std::memory_order_acquire)) {
+            return value_type();
+        }
+        /* The last object is unlinked through the stub. */
+        link(&m_stub);
+        p_next = p_tail->p_next.load(std::memory_order_acquire);
+        if (p_next != NULL) {
+            m_p_tail = p_next;
+            return adopt(p_tail);
+        }
+        return value_type();
+    }
+
+    /* Is exact for the consumer only. */
+    bool empty() const
+    {
+        return (m_p_tail == &m_stub && m_stub.p_next.load(std::memory_order_acquire) == NULL);
+    }
+
+private:
+    void link(__hook_type* p_hook)
+    {
+        p_hook->p_next.store(NULL, std::memory_order_relaxed);
+        __hook_type* p_prev = m_p_head.exchange(p_hook, std::memory_order_acq_rel);
+        p_prev->p_next.store(p_hook, std::memory_order_release);
+    }
+
+    static value_type adopt(__hook_type* p_hook) { return value_type(static_cast<T*>(p_hook), false); }
+
+private:
+    alignas(64) std::atomic<__hook_type*> m_p_head;
+    alignas(64) __hook_type* m_p_tail;
+    __hook_type m_stub;
+};
+
+/*
+ * Bounded multiple producers multiple consumers ring (Vyukov).
+ *
+ * Every cell has a sequence number that tells the producers and the consumers
+ * whose turn it is, so they contend only on the cells and on their indexes.
+ * The objects don't need a hook. The capacity is rounded up to a power of
+ * two.
+ */
+template<typename T>
+class mpmc_ring
+{
+    struct cell
+    {
+        std::atomic<size_t> sequence;
+        T* p;
+    };
+
+public:
+    typedef intrusive_ptr<T> value_type;
+
+    explicit mpmc_ring(size_t capacity)
+        : m_mask(round_up(capacity) - 1)
+        , m_cells(new cell[m_mask + 1])
+        , m_push_index(0)
+        , m_pop_index(0)
+    {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            m_cells[i].p = NULL;
+        }
+    }
+
+    mpmc_ring(const mpmc_ring&) = delete;
+    mpmc_ring& operator=(const mpmc_ring&) = delete;
+
+    ~mpmc_ring()
+    {
+        value_type ptr;
+        while (try_pop(ptr)) {
+        }
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    /* Moves the reference into the ring. If the ring is full, 'ptr' is left
+     * untouched and false is returned. */
+    bool try_push(value_type&& ptr)
+    {
+        assert(ptr);
+        size_t index = m_push_index.load(std::memory_order_relaxed);
+        for (;;) {
+            cell& c = m_cells[index & m_mask];
+            const size_t sequence = c.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(index);
+            if (diff == 0) {
+                if (m_push_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) {
+                    c.p = ptr.detach();
+                    c.sequence.store(index + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                index = m_push_index.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* Moves the reference out of the ring to 'ptr'. */
+    bool try_pop(value_type& ptr)
+    {
+        size_t index = m_pop_index.load(std::memory_order_relaxed);
+        for (;;) {
+            cell& c = m_cells[index & m_mask];
+            const size_t sequence = c.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(index + 1);
+            if (diff == 0) {
+                if (m_pop_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) {
+                    T* p = c.p;
+                    c.sequence.store(index + m_mask + 1, std::memory_order_release);
+                    ptr.reset(p, false);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                index = m_pop_index.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    static size_t round_up(size_t capacity)
+    {
+        size_t result = 2;
+        while (result < capacity) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+private:
+    const size_t m_mask;
+    std::unique_ptr<cell[]> m_cells;
+    alignas(64) std::atomic<size_t> m_push_index;
+    alignas(64) std::atomic<size_t> m_pop_index;
+};
+
+/*
+ * Lock-free stack (Treiber).
+ *
+ * The top of the stack is a split word: the pointer and a 16-bit counter of
+ * the pushes, so the top that has been popped and pushed again between the
+ * load and the compare-exchange of a pop (ABA) is detected. The counter wraps,
+ * the ABA is missed if exactly a multiple of 65536 pushes happen during one
+ * pop.
+ *
+ * pop() reads the link of the top object, that may be popped and released by
+ * another thread meanwhile, so the memory of the released objects must stay
+ * readable. pop() runs inside of an epoch_guard, which is enough for the
+ * objects with the epoch_destroy_policy. Otherwise the memory must be type
+ * stable (the objects with the slab_destroy_policy, whose slabs are never
+ * returned to the system) or the objects must be kept alive by other
+ * references.
+ */
+template<typename T, typename TTag = void>
+class treiber_stack
+{
+    typedef queue_hook<TTag> __hook_type;
+    typedef details::split_ptr_word __word;
+    typedef typename __word::word_type __word_type;
+
+public:
+    typedef intrusive_ptr<T> value_type;
+
+    treiber_stack()
+        : m_top(0)
+    {}
+
+    treiber_stack(const treiber_stack&) = delete;
+    treiber_stack& operator=(const treiber_stack&) = delete;
+
+    ~treiber_stack()
+    {
+        while (pop()) {
+        }
+    }
+
+    void push(value_type&& ptr)
+    {
+        assert(ptr);
+        __hook_type* p_hook = static_cast<__hook_type*>(ptr.detach());
+        __word_type top = m_top.load(std::memory_order_relaxed);
+        __word_type desired;
+        do {
+            p_hook->p_next.store(__word::ptr<__hook_type>(top), std::memory_order_relaxed);
+            desired = __word::pack(p_hook) | ((top + __word::kOne) & ~__word::kPtrMask);
+        } while (! m_top.compare_exchange_weak(top, desired,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+    }
+
+    value_type pop()
+    {
+        epoch_guard guard;
+        __word_type top = m_top.load(std::memory_order_acquire);
+        for (;;) {
+            __hook_type* p_hook = __word::ptr<__hook_type>(top);
+            if (p_hook == NULL) {
+                return value_type();
+            }
+            __hook_type* p_next = p_hook->p_next.load(std::memory_order_relaxed);
+            const __word_type desired = __word::pack(p_next) | (top & ~__word::kPtrMask);
+            if (m_top.compare_exchange_weak(top, desired,
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                return value_type(static_cast<T*>(p_hook), false);
+            }
+        }
+    }
+
+    bool empty() const { return (__word::ptr<__hook_type>(m_top.load(std::memory_order_relaxed)) == NULL); }
+
+private:
+    std::atomic<__word_type> m_top;
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_INTRUSIVE_QUEUE_H */
@@ -0,0 +1,153 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_INTRUSIVE_RANGE_H
+#define _INTRUSIVE_INTRUSIVE_RANGE_H
+
+#include <cstddef>
+#include <new>
+
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+namespace details {
+
+/* Count of the consecutive pointers equal to the first one. */
+template<typename T>
+inline size_t equal_run(const intrusive_ptr<T>* first, size_t count) noexcept
+{
+    size_t run = 1;
+    while (run < count && first[run].get() == first[0].get()) {
+        ++run;
+    }
+    return run;
+}
+
+/* Releases the references of the range, the equal consecutive pointers are
+ * released with one batched hook. */
+template<typename T>
+inline void release_runs(intrusive_ptr<T>* first, size_t count) noexcept
+{
+    for (size_t i = 0; i < count;) {
+        const size_t run = equal_run(first + i, count - i);
+        T* p = first[i].get();
+        for (size_t j = 0; j < run; ++j) {
+            first[i + j].detach();
+        }
+        if (p != NULL) {
+            details::release_n(p, run);
+        }
+        i += run;
+    }
+}
+
+} // namespace details
+
+/*
+ * Batched operations on ranges of intrusive pointers.
+ *
+ * Consecutive pointers to the same object share one add_ref(n) or
+ * release(n), so a range of handles to a few shared objects costs a few
+ * atomic operations instead of one per handle. The batched hooks are
+ * generated by intrusive_ref_counter and by the INIT_INTRUSIVE_PTR_* macros,
+ * for other classes the single hooks are repeated.
+ */
+
+/* Copies the range to the uninitialized storage at 'result'. Returns the end
+ * of the copied range. */
+template<typename T>
+inline intrusive_ptr<T>* uninitialized_copy_n(const intrusive_ptr<T>* first, size_t count,
+                                              intrusive_ptr<T>* result) noexcept
+{
+    for (size_t i = 0; i < count;) {
+        const size_t run = details::equal_run(first + i, count - i);
+        T* p = first[i].get();
+        if (p != NULL) {
+            details::add_ref_n(p, run);
+        }
+        for (size_t j = 0; j < run; ++j) {
+            ::new (static_cast<void*>(result + i + j)) intrusive_ptr<T>(p, false);
+        }
+        i += run;
+    }
+    return result + count;
+}
+
+/* Assigns the range to the pointers at 'result'. The ranges must not overlap
+ * unless they are the same. Returns the end of the assigned range. */
+template<typename T>
+inline intrusive_ptr<T>* copy_n(const intrusive_ptr<T>* first, size_t count,
+                                intrusive_ptr<T>* result) noexcept
+{
+    /* All references are taken before any is released: the released object
+     * may be referenced only by the assigned pointer. */
+    for (size_t i = 0; i < count;) {
+        const size_t run = details::equal_run(first + i, count - i);
+        if (first[i].get() != NULL) {
+            details::add_ref_n(first[i].get(), run);
+        }
+        i += run;
+    }
+
+    T* p_released = NULL;
+    size_t released_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        T* p_new = first[i].get();
+        T* p_old = result[i].detach();
+        result[i] = intrusive_ptr<T>(p_new, false);
+        if (p_old != p_released) {
+            if (p_released != NULL) {
+                details::release_n(p_released, released_count);
+            }
+            p_released = p_old;
+            released_count = 0;
+        }
+        ++released_count;
+    }
+    if (p_released != NULL) {
+        details::release_n(p_released, released_count);
+    }
+    return result + count;
+}
+
+/* Resets the pointers of the range. */
+template<typename T>
+inline void release_n(intrusive_ptr<T>* first, size_t count) noexcept
+{
+    details::release_runs(first, count);
+}
+
+/* Destroys the pointers of the range. */
+template<typename T>
+inline void destroy_n(intrusive_ptr<T>* first, size_t count) noexcept
+{
+    details::release_runs(first, count);
+    for (size_t i = 0; i < count; ++i) {
+        first[i].~intrusive_ptr();
+    }
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_INTRUSIVE_RANGE_H */
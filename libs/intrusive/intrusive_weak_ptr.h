@@ -0,0 +1,152 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_INTRUSIVE_WEAK_PTR_H
+#define _INTRUSIVE_INTRUSIVE_WEAK_PTR_H
+
+#include <cstddef>
+#include <type_traits>
+
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/relocate.h"
+#include "intrusive/weak_counter.h"
+
+namespace wstux {
+
+/*
+ * Weak intrusive pointer.
+ *
+ * Doesn't keep the object alive. The object must use the weak_counter_policy:
+ *
+ * class foo : public wstux::intrusive_ref_counter<foo, wstux::weak_counter_policy>
+ * { ... };
+ */
+template<typename T>
+class intrusive_weak_ptr INTRUSIVE_TRIVIALLY_RELOCATABLE
+{
+    typedef T* __ptr_type;
+
+public:
+    typedef T element_type;
+
+    intrusive_weak_ptr() noexcept
+        : m_ptr(NULL)
+        , m_p_block(NULL)
+    {}
+
+    intrusive_weak_ptr(const intrusive_ptr<T>& ptr)
+        : m_ptr(ptr.get())
+        , m_p_block((m_ptr != NULL) ? intrusive_ptr_add_weak_ref(m_ptr) : NULL)
+    {}
+
+    intrusive_weak_ptr(const intrusive_weak_ptr& rhs) noexcept
+        : m_ptr(rhs.m_ptr)
+        , m_p_block(rhs.m_p_block)
+    {
+        if (m_p_block != NULL) {
+            m_p_block->add_weak_ref();
+        }
+    }
+
+    intrusive_weak_ptr(intrusive_weak_ptr&& rhs) noexcept
+        : m_ptr(rhs.m_ptr)
+        , m_p_block(rhs.m_p_block)
+    {
+        rhs.m_ptr = NULL;
+        rhs.m_p_block = NULL;
+    }
+
+    ~intrusive_weak_ptr() noexcept
+    {
+        if (m_p_block != NULL) {
+            m_p_block->release_weak();
+        }
+    }
+
+    intrusive_weak_ptr& operator=(const intrusive_weak_ptr& rhs) noexcept
+    {
+        intrusive_weak_ptr(rhs).swap(*this);
+        return *this;
+    }
+
+    intrusive_weak_ptr& operator=(intrusive_weak_ptr&& rhs) noexcept
+    {
+        intrusive_weak_ptr(static_cast<intrusive_weak_ptr&&>(rhs)).swap(*this);
+        return *this;
+    }
+
+    intrusive_weak_ptr& operator=(const intrusive_ptr<T>& rhs)
+    {
+        intrusive_weak_ptr(rhs).swap(*this);
+        return *this;
+    }
+
+    size_t use_count() const noexcept { return (m_p_block != NULL) ? m_p_block->use_count() : 0; }
+
+    bool expired() const noexcept { return (use_count() == 0); }
+
+    /* Returns the empty pointer if the object has been destroyed. */
+    intrusive_ptr<T> lock() const noexcept
+    {
+        if (m_p_block == NULL || ! m_p_block->try_add_ref()) {
+            return intrusive_ptr<T>();
+        }
+        return intrusive_ptr<T>(m_ptr, false);
+    }
+
+    void swap(intrusive_weak_ptr& rhs) noexcept
+    {
+        __ptr_type p_tmp = m_ptr;
+        m_ptr = rhs.m_ptr;
+        rhs.m_ptr = p_tmp;
+
+        details::weak_ref_block* p_block = m_p_block;
+        m_p_block = rhs.m_p_block;
+        rhs.m_p_block = p_block;
+    }
+
+    void reset() noexcept { intrusive_weak_ptr().swap(*this); }
+
+private:
+    __ptr_type m_ptr;
+    details::weak_ref_block* m_p_block;
+};
+
+template<typename T>
+struct is_trivially_relocatable<intrusive_weak_ptr<T>> : std::true_type
+{};
+
+} // namespace wstux
+
+namespace std {
+
+template<typename T>
+void swap(::wstux::intrusive_weak_ptr<T>& lhs, ::wstux::intrusive_weak_ptr<T>& rhs) noexcept
+{
+    lhs.swap(rhs);
+}
+
+} // namespace std
+
+#endif /* _INTRUSIVE_INTRUSIVE_WEAK_PTR_H */
@@ -0,0 +1,106 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_RELOCATE_H
+#define _INTRUSIVE_RELOCATE_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/* Marks the class trivially relocatable for the compilers with the C++26
+ * trivial relocatability:
+ *
+ * class foo INTRUSIVE_TRIVIALLY_RELOCATABLE { ... };
+ */
+#if defined(__cpp_trivial_relocatability)
+    #define INTRUSIVE_TRIVIALLY_RELOCATABLE trivially_relocatable_if_eligible
+#else
+    #define INTRUSIVE_TRIVIALLY_RELOCATABLE
+#endif
+
+namespace wstux {
+
+/*
+ * A type is trivially relocatable if moving an object to a new address and
+ * ending the lifetime of the old one is equal to copying its bytes. The
+ * smart pointers of the library specialize the trait, other types may
+ * specialize it as well.
+ */
+template<typename T>
+struct is_trivially_relocatable
+#if defined(__cpp_lib_trivially_relocatable)
+    : std::integral_constant<bool, std::is_trivially_relocatable_v<T>>
+#else
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value>
+#endif
+{};
+
+/* Relocates the objects of [first, last) to the uninitialized storage at
+ * 'result'. The source objects are left destroyed, the ranges may overlap.
+ * Returns the end of the relocated range. */
+template<typename T>
+inline T* relocate(T* first, T* last, T* result) noexcept
+{
+    static_assert(is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value,
+                  "relocated type must be trivially relocatable or nothrow movable");
+
+    const std::ptrdiff_t count = last - first;
+    if constexpr (is_trivially_relocatable<T>::value) {
+        if (count > 0) {
+            std::memmove(static_cast<void*>(result), static_cast<const void*>(first),
+                         static_cast<size_t>(count) * sizeof(T));
+        }
+    } else {
+        if (result <= first || result >= last) {
+            for (T* p = first; p != last; ++p, ++result) {
+                ::new (static_cast<void*>(result)) T(std::move(*p));
+                p->~T();
+            }
+            return result;
+        }
+        /* The destination overlaps the tail of the source. */
+        for (T* p = last, *p_dst = result + count; p != first;) {
+            --p;
+            --p_dst;
+            ::new (static_cast<void*>(p_dst)) T(std::move(*p));
+            p->~T();
+        }
+    }
+    return result + count;
+}
+
+/* Relocates one object to the uninitialized storage at 'p_dst'. */
+template<typename T>
+inline T* relocate_at(T* p_src, T* p_dst) noexcept
+{
+    relocate(p_src, p_src + 1, p_dst);
+    return p_dst;
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_RELOCATE_H */
@@ -0,0 +1,205 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_SHARDED_COUNTER_H
+#define _INTRUSIVE_SHARDED_COUNTER_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace wstux {
+namespace details {
+
+static const size_t kCacheLineSize = 64;
+
+/* Index of the current thread. Indexes are given out in order, so the first
+ * threads never share a shard. */
+inline size_t current_shard_index()
+{
+    static std::atomic<size_t> next_index(0);
+    static thread_local size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+} // namespace details
+
+/*
+ * Sharded counter for hot objects that are copied by many threads.
+ *
+ * Every thread counts its references in its own shard which lives in its own
+ * cache line, so the threads do not contend. The object has the base
+ * reference that keeps it alive while the counter is sharded. The base
+ * reference is dropped by wstux::retire(): the shards are drained into the
+ * central counter and from that moment all threads use the central counter
+ * only. The object is never destroyed before it is retired.
+ *
+ * A shard is drained by replacing it with a 'poisoned' value, so a thread that
+ * has touched a drained shard sees it from the previous value and repeats the
+ * operation on the central counter.
+ */
+template<typename TValue = size_t, size_t TShards = 16>
+struct sharded_counter_policy
+{
+    static_assert(std::is_integral<TValue>::value, "counter value must be integral");
+    static_assert(TShards > 0 && (TShards & (TShards - 1)) == 0,
+                  "shards count must be a power of two");
+
+    typedef TValue value_type;
+
+    class counter_type
+    {
+        friend struct sharded_counter_policy;
+
+        typedef typename std::make_signed<TValue>::type shared_type;
+
+        struct alignas(details::kCacheLineSize) shard
+        {
+            std::atomic<shared_type> value;
+        };
+
+    public:
+        explicit counter_type(value_type value)
+            : m_central(static_cast<shared_type>(value) + 1)
+        {
+            for (size_t i = 0; i < TShards; ++i) {
+                m_shards[i].value.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        counter_type(const counter_type&) = delete;
+        counter_type& operator=(const counter_type&) = delete;
+
+    private:
+        shard m_shards[TShards];
+        alignas(details::kCacheLineSize) std::atomic<shared_type> m_central;
+    };
+
+    /* Is approximate while the counter is sharded. */
+    static value_type load(const counter_type& c)
+    {
+        const shared_type central = c.m_central.load(std::memory_order_relaxed);
+        if (is_retired(c)) {
+            return static_cast<value_type>(central);
+        }
+        shared_type count = central - 1;
+        for (size_t i = 0; i < TShards; ++i) {
+            count += c.m_shards[i].value.load(std::memory_order_relaxed);
+        }
+        return static_cast<value_type>(count);
+    }
+
+    static void increment(counter_type& c)
+    {
+        if (is_poisoned(shard(c).fetch_add(1, std::memory_order_relaxed))) {
+            c.m_central.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /* The shard that is not drained yet is counted by retire(), so the object
+     * is alive. */
+    static bool try_increment(counter_type& c)
+    {
+        if (! is_poisoned(shard(c).fetch_add(1, std::memory_order_relaxed))) {
+            return true;
+        }
+        shared_type central = c.m_central.load(std::memory_order_relaxed);
+        while (central != 0) {
+            if (c.m_central.compare_exchange_weak(central, central + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool decrement(counter_type& c)
+    {
+        /* The base reference is not dropped, so the object can't die. */
+        if (! is_poisoned(shard(c).fetch_sub(1, std::memory_order_release))) {
+            return false;
+        }
+        return (c.m_central.fetch_sub(1, std::memory_order_acq_rel) == 1);
+    }
+
+    /* The sum of the shards is approximate, so the object is never unique
+     * while the counter is sharded. */
+    static bool is_unique(const counter_type& c)
+    {
+        return (is_retired(c) && c.m_central.load(std::memory_order_relaxed) == 1);
+    }
+
+    /* Drops the base reference. Must be called once. */
+    static bool retire(counter_type& c)
+    {
+        assert(! is_retired(c));
+
+        /* The bias keeps the central counter positive while it doesn't
+         * contain the drained shards. */
+        c.m_central.fetch_add(kBias, std::memory_order_relaxed);
+        shared_type drained = 0;
+        for (size_t i = 0; i < TShards; ++i) {
+            drained += c.m_shards[i].value.exchange(kPoison, std::memory_order_acq_rel);
+        }
+        const shared_type delta = kBias + 1 - drained;
+        return (c.m_central.fetch_sub(delta, std::memory_order_acq_rel) == delta);
+    }
+
+private:
+    typedef typename counter_type::shared_type shared_type;
+
+    static const shared_type kPoison = std::numeric_limits<shared_type>::min() / 2;
+    static const shared_type kBias = std::numeric_limits<shared_type>::max() / 4;
+
+    static std::atomic<shared_type>& shard(counter_type& c)
+    {
+        return c.m_shards[details::current_shard_index() & (TShards - 1)].value;
+    }
+
+    static bool is_poisoned(shared_type value) { return (value < kPoison / 2); }
+
+    static bool is_retired(const counter_type& c)
+    {
+        return is_poisoned(c.m_shards[0].value.load(std::memory_order_relaxed));
+    }
+};
+
+/* Drops the base reference of the object with the sharded counter and the
+ * reference held by 'ptr'. */
+template<typename T>
+inline void retire(intrusive_ptr<T>& ptr)
+{
+    if (ptr) {
+        intrusive_ptr_retire(ptr.get());
+        ptr.reset();
+    }
+}
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_SHARDED_COUNTER_H */
@@ -0,0 +1,315 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_SLAB_POOL_H
+#define _INTRUSIVE_SLAB_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "intrusive/allocate_intrusive.h"
+
+namespace wstux {
+namespace details {
+
+static const size_t kSlabSize = 64 * 1024;
+static const size_t kSlabHeaderSize = 64;
+static const size_t kSlabGranularity = 16;
+static const size_t kSlabMaxBlockSize = 512;
+static const size_t kSlabClassCount = kSlabMaxBlockSize / kSlabGranularity;
+
+struct slab_block
+{
+    slab_block* p_next;
+};
+
+class slab_cache;
+
+/* Header at the start of every slab. Slabs are aligned to their size, so the
+ * header of a block is found by masking its address. */
+struct slab_header
+{
+    slab_cache* p_owner;
+    size_t size_class;
+};
+
+inline slab_header* slab_of(void* p)
+{
+    return reinterpret_cast<slab_header*>(reinterpret_cast<uintptr_t>(p) & ~(kSlabSize - 1));
+}
+
+/*
+ * Cache of one thread. The blocks released by the owner thread go to the local
+ * free lists, the blocks released by the other threads go to the lock-free
+ * remote list, that the owner takes at once when its local list is empty.
+ *
+ * The slabs are never returned to the system. The cache of an exited thread
+ * is orphaned with its slabs and is adopted by the next new thread.
+ */
+class slab_cache
+{
+public:
+    slab_cache()
+        : m_p_remote(NULL)
+        , m_p_next_orphan(NULL)
+    {
+        for (size_t i = 0; i < kSlabClassCount; ++i) {
+            m_p_free[i] = NULL;
+            m_p_bump[i] = NULL;
+            m_p_end[i] = NULL;
+        }
+    }
+
+    slab_cache(const slab_cache&) = delete;
+    slab_cache& operator=(const slab_cache&) = delete;
+
+    void* allocate(size_t size_class)
+    {
+        if (m_p_free[size_class] == NULL && m_p_remote.load(std::memory_order_relaxed) != NULL) {
+            take_remote();
+        }
+        slab_block* p_block = m_p_free[size_class];
+        if (p_block != NULL) {
+            m_p_free[size_class] = p_block->p_next;
+            return p_block;
+        }
+        if (m_p_bump[size_class] == m_p_end[size_class]) {
+            new_slab(size_class);
+        }
+        void* p = m_p_bump[size_class];
+        m_p_bump[size_class] += block_size(size_class);
+        return p;
+    }
+
+    /* Is called by the owner thread only. */
+    void deallocate_local(void* p, size_t size_class)
+    {
+        slab_block* p_block = static_cast<slab_block*>(p);
+        p_block->p_next = m_p_free[size_class];
+        m_p_free[size_class] = p_block;
+    }
+
+    void deallocate_remote(void* p)
+    {
+        slab_block* p_block = static_cast<slab_block*>(p);
+        slab_block* p_head = m_p_remote.load(std::memory_order_relaxed);
+        do {
+            p_block->p_next = p_head;
+        } while (! m_p_remote.compare_exchange_weak(p_head, p_block,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed));
+    }
+
+    static slab_cache*& local_ref()
+    {
+        static thread_local slab_cache* p_cache = NULL;
+        return p_cache;
+    }
+
+    /* Returns the cache of the current thread or NULL if the thread is being
+     * destroyed. */
+    static slab_cache* local()
+    {
+        slab_cache*& p_cache = local_ref();
+        if (p_cache == NULL) {
+            p_cache = adopt();
+            static thread_local guard g;
+            (void)g;
+        }
+        return (p_cache != exited()) ? p_cache : NULL;
+    }
+
+    /* Cache for the threads that are being destroyed, it is used under the
+     * lock. */
+    static slab_cache& shared(std::unique_lock<std::mutex>& lock)
+    {
+        static slab_cache cache;
+        lock = std::unique_lock<std::mutex>(orphans_mutex());
+        return cache;
+    }
+
+private:
+    struct guard
+    {
+        ~guard()
+        {
+            slab_cache* p_cache = local_ref();
+            local_ref() = exited();
+
+            std::lock_guard<std::mutex> lock(orphans_mutex());
+            p_cache->m_p_next_orphan = orphans();
+            orphans() = p_cache;
+        }
+    };
+
+    static size_t block_size(size_t size_class) { return (size_class + 1) * kSlabGranularity; }
+
+    void take_remote()
+    {
+        slab_block* p_block = m_p_remote.exchange(NULL, std::memory_order_acquire);
+        while (p_block != NULL) {
+            slab_block* p_next = p_block->p_next;
+            deallocate_local(p_block, slab_of(p_block)->size_class);
+            p_block = p_next;
+        }
+    }
+
+    void new_slab(size_t size_class)
+    {
+        char* p_slab = static_cast<char*>(::operator new(kSlabSize, std::align_val_t(kSlabSize)));
+        slab_header* p_header = ::new (p_slab) slab_header();
+        p_header->p_owner = this;
+        p_header->size_class = size_class;
+
+        const size_t size = block_size(size_class);
+        m_p_bump[size_class] = p_slab + kSlabHeaderSize;
+        m_p_end[size_class] = m_p_bump[size_class] + (kSlabSize - kSlabHeaderSize) / size * size;
+    }
+
+    static slab_cache* adopt()
+    {
+        std::lock_guard<std::mutex> lock(orphans_mutex());
+        slab_cache* p_cache = orphans();
+        if (p_cache == NULL) {
+            return new slab_cache();
+        }
+        orphans() = p_cache->m_p_next_orphan;
+        p_cache->m_p_next_orphan = NULL;
+        return p_cache;
+    }
+
+    static std::mutex& orphans_mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static slab_cache*& orphans()
+    {
+        static slab_cache* p_orphans = NULL;
+        return p_orphans;
+    }
+
+    static slab_cache* exited()
+    {
+        static slab_cache exited_cache;
+        return &exited_cache;
+    }
+
+private:
+    slab_block* m_p_free[kSlabClassCount];
+    char* m_p_bump[kSlabClassCount];
+    char* m_p_end[kSlabClassCount];
+    alignas(64) std::atomic<slab_block*> m_p_remote;
+    slab_cache* m_p_next_orphan;
+};
+
+inline bool is_slab_size(size_t size, size_t align)
+{
+    return (size <= kSlabMaxBlockSize && align <= kSlabGranularity);
+}
+
+inline size_t slab_size_class(size_t size) { return (size + kSlabGranularity - 1) / kSlabGranularity - 1; }
+
+} // namespace details
+
+/*
+ * Allocates the memory from the slab pool of the current thread. Blocks that
+ * are bigger than 512 bytes or over-aligned are allocated by operator new.
+ */
+inline void* slab_allocate(size_t size, size_t align = alignof(std::max_align_t))
+{
+    if (! details::is_slab_size(size, align)) {
+        return ::operator new(size, std::align_val_t(align));
+    }
+    const size_t size_class = details::slab_size_class((size != 0) ? size : 1);
+    details::slab_cache* p_cache = details::slab_cache::local();
+    if (p_cache != NULL) {
+        return p_cache->allocate(size_class);
+    }
+    std::unique_lock<std::mutex> lock;
+    return details::slab_cache::shared(lock).allocate(size_class);
+}
+
+/* Returns the memory to the pool of the thread that has allocated it. */
+inline void slab_deallocate(void* p, size_t size, size_t align = alignof(std::max_align_t))
+{
+    if (! details::is_slab_size(size, align)) {
+        ::operator delete(p, std::align_val_t(align));
+        return;
+    }
+    details::slab_header* p_slab = details::slab_of(p);
+    if (p_slab->p_owner == details::slab_cache::local_ref()) {
+        p_slab->p_owner->deallocate_local(p, p_slab->size_class);
+    } else {
+        p_slab->p_owner->deallocate_remote(p);
+    }
+}
+
+/* Allocator of the slab pool. */
+template<typename T>
+class slab_allocator
+{
+public:
+    typedef T value_type;
+
+    slab_allocator() = default;
+
+    template<typename U>
+    slab_allocator(const slab_allocator<U>& /*rhs*/)
+    {}
+
+    T* allocate(size_t n) { return static_cast<T*>(slab_allocate(n * sizeof(T), alignof(T))); }
+
+    void deallocate(T* p, size_t n) { slab_deallocate(p, n * sizeof(T), alignof(T)); }
+};
+
+template<typename T, typename U>
+inline bool operator==(const slab_allocator<T>& /*lhs*/, const slab_allocator<U>& /*rhs*/)
+{
+    return true;
+}
+
+template<typename T, typename U>
+inline bool operator!=(const slab_allocator<T>& /*lhs*/, const slab_allocator<U>& /*rhs*/)
+{
+    return false;
+}
+
+/*
+ * Destroy policy of the objects created from the slab pool by make_intrusive().
+ *
+ * class message : public wstux::intrusive_ref_counter<message,
+ *                                                     wstux::relaxed_atomic_counter_policy<size_t>,
+ *                                                     wstux::slab_destroy_policy>
+ * { ... };
+ */
+typedef basic_allocator_destroy_policy<slab_allocator<char>> slab_destroy_policy;
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_SLAB_POOL_H */
@@ -0,0 +1,217 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_TAGGED_INTRUSIVE_PTR_H
+#define _INTRUSIVE_TAGGED_INTRUSIVE_PTR_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/relocate.h"
+
+namespace wstux {
+
+/*
+ * Tagged intrusive pointer.
+ *
+ * Owning pointer that keeps 'TBits' user bits in the low bits of the pointer,
+ * which are always zero for the aligned objects. The pointer has the size of
+ * a raw pointer, so a node of a tree keeps a flag of each child link without
+ * growing:
+ *
+ * struct node : public wstux::intrusive_ref_counter<node>
+ * {
+ *     wstux::tagged_intrusive_ptr<node, 1> children[16];
+ * };
+ *
+ * get(), operator-> and the reference counting hooks see the pointer with the
+ * tag bits cleared. 'T' must be aligned at least to '1 << TBits' bytes. The
+ * tag wider than 'TBits' aborts in all builds.
+ */
+template<typename T, unsigned TBits>
+class tagged_intrusive_ptr INTRUSIVE_TRIVIALLY_RELOCATABLE
+{
+    static_assert(TBits > 0 && TBits < 8, "invalid count of the tag bits");
+
+    typedef uintptr_t __word_type;
+
+public:
+    typedef T element_type;
+    typedef uintptr_t tag_type;
+
+    static const tag_type kTagMask = (tag_type(1) << TBits) - 1;
+
+    tagged_intrusive_ptr() noexcept
+        : m_word(0)
+    {}
+
+    /* If 'add_ref' is false, the pointer adopts the reference that the caller
+     * already owns. */
+    tagged_intrusive_ptr(element_type* ptr, tag_type tag = 0, bool add_ref = true) noexcept
+        : m_word(pack(ptr, tag))
+    {
+        if (ptr != NULL && add_ref) {
+            intrusive_ptr_add_ref(ptr);
+        }
+    }
+
+    /* Takes the reference of 'ptr'. */
+    tagged_intrusive_ptr(intrusive_ptr<T> ptr, tag_type tag = 0) noexcept
+        : m_word(pack(ptr.detach(), tag))
+    {}
+
+    tagged_intrusive_ptr(const tagged_intrusive_ptr& rhs) noexcept
+        : m_word(rhs.m_word)
+    {
+        element_type* p = get();
+        if (p != NULL) {
+            intrusive_ptr_add_ref(p);
+        }
+    }
+
+    tagged_intrusive_ptr(tagged_intrusive_ptr&& rhs) noexcept
+        : m_word(rhs.m_word)
+    {
+        rhs.m_word = 0;
+    }
+
+    ~tagged_intrusive_ptr() noexcept
+    {
+        element_type* p = get();
+        if (p != NULL) {
+            intrusive_ptr_release(p);
+        }
+    }
+
+    tagged_intrusive_ptr& operator=(const tagged_intrusive_ptr& rhs) noexcept
+    {
+        tagged_intrusive_ptr(rhs).swap(*this);
+        return *this;
+    }
+
+    tagged_intrusive_ptr& operator=(tagged_intrusive_ptr&& rhs) noexcept
+    {
+        tagged_intrusive_ptr(static_cast<tagged_intrusive_ptr&&>(rhs)).swap(*this);
+        return *this;
+    }
+
+    element_type& operator*() const noexcept { assert(get() != NULL); return *get(); }
+
+    element_type* operator->() const noexcept { assert(get() != NULL); return get(); }
+
+    bool operator!() const noexcept { return (get() == NULL); }
+
+    explicit operator bool () const noexcept { return (get() != NULL); }
+
+    element_type* get() const noexcept { return reinterpret_cast<element_type*>(m_word & ~kTagMask); }
+
+    tag_type tag() const noexcept { return (m_word & kTagMask); }
+
+    /* The tag is kept by the empty pointer as well. */
+    void set_tag(tag_type tag) noexcept
+    {
+        m_word = (m_word & ~kTagMask) | check_tag(tag);
+    }
+
+    /* Returns an owning pointer without the tag. */
+    intrusive_ptr<T> promote() const noexcept { return intrusive_ptr<T>(get()); }
+
+    /* Gives up the reference without releasing it, the tag is cleared. */
+    element_type* detach() noexcept
+    {
+        element_type* p = get();
+        m_word = 0;
+        return p;
+    }
+
+    void swap(tagged_intrusive_ptr& rhs) noexcept
+    {
+        __word_type tmp = m_word;
+        m_word = rhs.m_word;
+        rhs.m_word = tmp;
+    }
+
+    void reset() noexcept { tagged_intrusive_ptr().swap(*this); }
+
+    void reset(element_type* rhs, tag_type tag = 0) noexcept { tagged_intrusive_ptr(rhs, tag).swap(*this); }
+
+private:
+    /* Checked here and not in the class, 'T' may be incomplete there. */
+    static __word_type pack(element_type* p, tag_type tag) noexcept
+    {
+        static_assert(alignof(T) >= (uintptr_t(1) << TBits),
+                      "tag bits don't fit into the alignment of the object");
+        return reinterpret_cast<__word_type>(p) | check_tag(tag);
+    }
+
+    /* The check is kept in the release builds, the wide tag would corrupt
+     * the pointer. */
+    static tag_type check_tag(tag_type tag) noexcept
+    {
+        if ((tag & ~kTagMask) != 0) {
+            std::abort();
+        }
+        return tag;
+    }
+
+private:
+    __word_type m_word;
+};
+
+template<typename T, unsigned TBits>
+struct is_trivially_relocatable<tagged_intrusive_ptr<T, TBits>> : std::true_type
+{};
+
+/* The pointers are equal if both the objects and the tags are equal. */
+template<typename T, unsigned TBits>
+inline bool operator==(const tagged_intrusive_ptr<T, TBits>& lhs,
+                       const tagged_intrusive_ptr<T, TBits>& rhs) noexcept
+{
+    return lhs.get() == rhs.get() && lhs.tag() == rhs.tag();
+}
+
+template<typename T, unsigned TBits>
+inline bool operator!=(const tagged_intrusive_ptr<T, TBits>& lhs,
+                       const tagged_intrusive_ptr<T, TBits>& rhs) noexcept
+{
+    return ! (lhs == rhs);
+}
+
+} // namespace wstux
+
+namespace std {
+
+template<typename T, unsigned TBits>
+void swap(::wstux::tagged_intrusive_ptr<T, TBits>& lhs, ::wstux::tagged_intrusive_ptr<T, TBits>& rhs) noexcept
+{
+    lhs.swap(rhs);
+}
+
+} // namespace std
+
+#endif /* _INTRUSIVE_TAGGED_INTRUSIVE_PTR_H */
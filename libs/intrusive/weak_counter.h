@@ -0,0 +1,229 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _INTRUSIVE_WEAK_COUNTER_H
+#define _INTRUSIVE_WEAK_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "intrusive/intrusive_counter.h"
+
+namespace wstux {
+namespace details {
+
+/*
+ * Side block of an object that has weak references. The block holds the
+ * strong counter of the object from the moment it is allocated, so the weak
+ * references can check that the object is alive. The object holds a weak
+ * reference to the block until it is destroyed.
+ */
+class weak_ref_block
+{
+public:
+    explicit weak_ref_block(size_t use_count)
+        : m_strong(use_count)
+        , m_weak(1)
+    {}
+
+    weak_ref_block(const weak_ref_block&) = delete;
+    weak_ref_block& operator=(const weak_ref_block&) = delete;
+
+    size_t use_count() const { return m_strong.load(std::memory_order_relaxed); }
+
+    void set_use_count(size_t use_count) { m_strong.store(use_count, std::memory_order_relaxed); }
+
+    void add_ref() { m_strong.fetch_add(1, std::memory_order_relaxed); }
+
+    bool release()
+    {
+        if (m_strong.fetch_sub(1, std::memory_order_release) != 1) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    /* Takes a strong reference if the object is still alive. */
+    bool try_add_ref()
+    {
+        size_t strong = m_strong.load(std::memory_order_relaxed);
+        while (strong != 0) {
+            if (m_strong.compare_exchange_weak(strong, strong + 1,
+                                               std::memory_order_relaxed,
+                                               std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add_weak_ref() { m_weak.fetch_add(1, std::memory_order_relaxed); }
+
+    void release_weak()
+    {
+        if (m_weak.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+private:
+    std::atomic<size_t> m_strong;
+    std::atomic<size_t> m_weak;
+};
+
+} // namespace details
+
+/*
+ * Atomic counter with the weak references support.
+ *
+ * The counter is one word. While the object has no weak references the word
+ * holds the reference count shifted left by one bit. The first weak reference
+ * allocates the side block, moves the count to it and stores the address of
+ * the block with the lowest bit set. The block is never moved back.
+ */
+struct weak_counter_policy
+{
+    typedef size_t value_type;
+
+    class counter_type
+    {
+        friend struct weak_counter_policy;
+
+    public:
+        explicit counter_type(value_type value)
+            : m_word(value << 1)
+        {}
+
+        ~counter_type()
+        {
+            details::weak_ref_block* p_block = block(m_word.load(std::memory_order_relaxed));
+            if (p_block != NULL) {
+                p_block->release_weak();
+            }
+        }
+
+        counter_type(const counter_type&) = delete;
+        counter_type& operator=(const counter_type&) = delete;
+
+    private:
+        std::atomic<uintptr_t> m_word;
+    };
+
+    static value_type load(const counter_type& c)
+    {
+        const uintptr_t word = c.m_word.load(std::memory_order_relaxed);
+        details::weak_ref_block* p_block = block(word);
+        return (p_block != NULL) ? p_block->use_count() : (word >> 1);
+    }
+
+    static void increment(counter_type& c)
+    {
+        uintptr_t word = c.m_word.load(std::memory_order_relaxed);
+        do {
+            if (is_block(word)) {
+                block(word)->add_ref();
+                return;
+            }
+        } while (! c.m_word.compare_exchange_weak(word, word + kOne,
+                                                  std::memory_order_relaxed,
+                                                  std::memory_order_relaxed));
+    }
+
+    static bool try_increment(counter_type& c)
+    {
+        uintptr_t word = c.m_word.load(std::memory_order_relaxed);
+        do {
+            if (is_block(word)) {
+                return block(word)->try_add_ref();
+            }
+            if (word == 0) {
+                return false;
+            }
+        } while (! c.m_word.compare_exchange_weak(word, word + kOne,
+                                                  std::memory_order_relaxed,
+                                                  std::memory_order_relaxed));
+        return true;
+    }
+
+    static bool decrement(counter_type& c)
+    {
+        uintptr_t word = c.m_word.load(std::memory_order_relaxed);
+        do {
+            if (is_block(word)) {
+                return block(word)->release();
+            }
+        } while (! c.m_word.compare_exchange_weak(word, word - kOne,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+        if (word != kOne) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    /* Returns the side block with a new weak reference. Is called for an
+     * alive object only. */
+    static details::weak_ref_block* add_weak_ref(counter_type& c)
+    {
+        uintptr_t word = c.m_word.load(std::memory_order_acquire);
+        details::weak_ref_block* p_new = NULL;
+        while (! is_block(word)) {
+            if (p_new == NULL) {
+                p_new = new details::weak_ref_block(word >> 1);
+            } else {
+                p_new->set_use_count(word >> 1);
+            }
+            const uintptr_t desired = reinterpret_cast<uintptr_t>(p_new) | kBlockFlag;
+            if (c.m_word.compare_exchange_weak(word, desired,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire)) {
+                p_new->add_weak_ref();
+                return p_new;
+            }
+        }
+        /* Another thread has allocated the block first. */
+        delete p_new;
+        details::weak_ref_block* p_block = block(word);
+        p_block->add_weak_ref();
+        return p_block;
+    }
+
+private:
+    static const uintptr_t kBlockFlag = 1;
+    static const uintptr_t kOne = 2;
+
+    static bool is_block(uintptr_t word) { return ((word & kBlockFlag) != 0); }
+
+    static details::weak_ref_block* block(uintptr_t word)
+    {
+        return is_block(word) ? reinterpret_cast<details::weak_ref_block*>(word & ~kBlockFlag) : NULL;
+    }
+};
+
+} // namespace wstux
+
+#endif /* _INTRUSIVE_WEAK_COUNTER_H */
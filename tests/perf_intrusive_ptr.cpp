@@ -22,27 +22,62 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <testing/perfdefs.h>
 #include <testing/utils.h>
 
+#include "intrusive/aliasing_ptr.h"
+#include "intrusive/atomic_intrusive_ptr.h"
+#include "intrusive/biased_counter.h"
+#include "intrusive/borrowed_ptr.h"
+#include "intrusive/checked_counter.h"
+#include "intrusive/clock_cache.h"
+#include "intrusive/concurrent_hash_map.h"
+#include "intrusive/cow_ptr.h"
+#include "intrusive/deferred_destroy.h"
+#include "intrusive/epoch.h"
+#include "intrusive/hazard_pointer.h"
+#include "intrusive/immortal_counter.h"
 #include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_hash_set.h"
+#include "intrusive/intrusive_list.h"
 #include "intrusive/intrusive_ptr.h"
+#include "intrusive/intrusive_queue.h"
+#include "intrusive/intrusive_range.h"
+#include "intrusive/sharded_counter.h"
+#include "intrusive/slab_pool.h"
 
 namespace {
 
 static const size_t kIterationCount = 1000000;
+static const size_t kThreadCount = 4;
 
 template<typename T>
-class intrusive_fixture : public ::testing::Test
+class perf_fixture : public ::testing::Test
 {
 public:
     virtual void SetUp() override {}
     virtual void TearDown() override {}
 };
 
+/* Registers the typed suite 'case_name' on the shared fixture, the name of
+ * the suite groups the report. */
+#define PERF_FIXTURE_SUITE(case_name, types)                                   \
+    template<typename T>                                                       \
+    using case_name = perf_fixture<T>;                                         \
+    TYPED_PERF_TEST_SUITE(case_name, types)
+
 
 class base_counter
 {
@@ -58,10 +93,596 @@ public:
     size_t counter = 0;
 };
 
+class acq_rel_counter
+    : public ::wstux::intrusive_ref_counter<acq_rel_counter,
+                                           ::wstux::acq_rel_atomic_counter_policy<size_t>>
+{
+public:
+    size_t counter = 0;
+};
+
+class seq_cst_counter
+    : public ::wstux::intrusive_ref_counter<seq_cst_counter,
+                                           ::wstux::atomic_counter_policy<size_t>>
+{
+public:
+    size_t counter = 0;
+};
+
+class biased_counter
+    : public ::wstux::intrusive_ref_counter<biased_counter,
+                                           ::wstux::biased_counter_policy<size_t>>
+{
+public:
+    size_t counter = 0;
+};
+
+class sharded_counter
+    : public ::wstux::intrusive_ref_counter<sharded_counter,
+                                           ::wstux::sharded_counter_policy<size_t>>
+{
+public:
+    size_t counter = 0;
+};
+
+class pooled_counter
+    : public ::wstux::intrusive_ref_counter<pooled_counter,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::slab_destroy_policy>
+{
+public:
+    size_t counter = 0;
+};
+
+class immortal_counter
+    : public ::wstux::intrusive_ref_counter<immortal_counter,
+                                           ::wstux::immortal_counter_policy<size_t>>
+{
+public:
+    size_t counter = 0;
+};
+
+template<typename TPtr>
+TPtr create() { return ::wstux::make_intrusive<typename TPtr::element_type>(); }
+
+/* Static singleton shared by all threads. */
+template<>
+::wstux::intrusive_ptr<immortal_counter> create<::wstux::intrusive_ptr<immortal_counter>>()
+{
+    static const ::wstux::intrusive_ptr<immortal_counter> singleton = [] {
+        ::wstux::intrusive_ptr<immortal_counter> ptr = ::wstux::make_intrusive<immortal_counter>();
+        ::wstux::make_immortal(ptr);
+        return ptr;
+    }();
+    return singleton;
+}
+
+template<>
+std::shared_ptr<base_counter> create<std::shared_ptr<base_counter>>()
+{
+    return std::shared_ptr<base_counter>(new base_counter());
+}
+
+template<typename TPtr>
+void release(TPtr& ptr) { ptr.reset(); }
+
+void release(::wstux::intrusive_ptr<sharded_counter>& ptr) { ::wstux::retire(ptr); }
+
 using types = testing::Types<::wstux::intrusive_ptr<base_counter>,
                              ::wstux::intrusive_ptr<base_atomic_counter>,
+                             ::wstux::intrusive_ptr<pooled_counter>,
+                             ::wstux::intrusive_ptr<acq_rel_counter>,
+                             ::wstux::intrusive_ptr<seq_cst_counter>,
+                             ::wstux::intrusive_ptr<biased_counter>,
                              std::shared_ptr<base_counter>>;
-TYPED_PERF_TEST_SUITE(intrusive_fixture, types);
+PERF_FIXTURE_SUITE(intrusive_fixture, types);
+
+using atomic_types = testing::Types<::wstux::intrusive_ptr<base_atomic_counter>,
+                                    ::wstux::intrusive_ptr<acq_rel_counter>,
+                                    ::wstux::intrusive_ptr<seq_cst_counter>,
+                                    ::wstux::intrusive_ptr<biased_counter>,
+                                    ::wstux::intrusive_ptr<sharded_counter>,
+                                    ::wstux::intrusive_ptr<immortal_counter>,
+                                    std::shared_ptr<base_counter>>;
+PERF_FIXTURE_SUITE(atomic_fixture, atomic_types);
+
+/* Published pointer guarded by a mutex, the baseline for the atomic one. */
+template<typename T>
+class locked_intrusive_ptr
+{
+public:
+    typedef ::wstux::intrusive_ptr<T> value_type;
+
+    explicit locked_intrusive_ptr(value_type ptr)
+        : m_ptr(std::move(ptr))
+    {}
+
+    value_type load() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ptr;
+    }
+
+    void store(value_type ptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ptr.swap(ptr);
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    value_type m_ptr;
+};
+
+using publish_types = testing::Types<::wstux::atomic_intrusive_ptr<base_atomic_counter>,
+                                     locked_intrusive_ptr<base_atomic_counter>>;
+PERF_FIXTURE_SUITE(publish_fixture, publish_types);
+
+/* Single producer single consumer ring for the handoff between threads. */
+template<typename T, size_t TSize>
+class spsc_ring
+{
+public:
+    bool push(T& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == TSize) {
+            return false;
+        }
+        m_items[tail % TSize] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(m_items[head % TSize]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T m_items[TSize];
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+using handoff_types = testing::Types<::wstux::intrusive_ptr<base_atomic_counter>,
+                                     ::wstux::intrusive_ptr<pooled_counter>>;
+PERF_FIXTURE_SUITE(handoff_fixture, handoff_types);
+
+template<typename TDestroyPolicy>
+class graph_node
+    : public ::wstux::intrusive_ref_counter<graph_node<TDestroyPolicy>,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           TDestroyPolicy>
+    , public ::wstux::deferred_hook
+{
+public:
+    std::vector<::wstux::intrusive_ptr<graph_node>> children;
+};
+
+using release_types = testing::Types<graph_node<::wstux::delete_destroy_policy>,
+                                     graph_node<::wstux::deferred_destroy_policy<>>>;
+PERF_FIXTURE_SUITE(release_fixture, release_types);
+
+class epoch_counter
+    : public ::wstux::intrusive_ref_counter<epoch_counter,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::epoch_destroy_policy<>>
+    , public ::wstux::epoch_hook
+{
+public:
+    size_t value = 1;
+};
+
+class hazard_counter
+    : public ::wstux::intrusive_ref_counter<hazard_counter,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::hazard_destroy_policy<>>
+    , public ::wstux::hazard_hook
+{
+public:
+    size_t value = 1;
+};
+
+/* Reader that owns the loaded object for the time of the access. */
+struct refcount_reader
+{
+    typedef epoch_counter element_type;
+
+    static size_t read(const ::wstux::atomic_intrusive_ptr<epoch_counter>& published)
+    {
+        ::wstux::intrusive_ptr<epoch_counter> ptr = published.load();
+        return ptr->value;
+    }
+};
+
+/* Reader that is protected by the epoch and doesn't touch the counter. */
+struct epoch_reader
+{
+    typedef epoch_counter element_type;
+
+    static size_t read(const ::wstux::atomic_intrusive_ptr<epoch_counter>& published)
+    {
+        ::wstux::epoch_guard guard;
+        return published.get()->value;
+    }
+};
+
+/* Reader that is protected by the hazard pointer and doesn't touch the
+ * counter. */
+struct hazard_reader
+{
+    typedef hazard_counter element_type;
+
+    static size_t read(const ::wstux::atomic_intrusive_ptr<hazard_counter>& published)
+    {
+        static thread_local ::wstux::hazard_pointer hp;
+        const size_t value = hp.protect(published)->value;
+        hp.reset();
+        return value;
+    }
+};
+
+using lookup_types = testing::Types<refcount_reader, epoch_reader, hazard_reader>;
+PERF_FIXTURE_SUITE(lookup_fixture, lookup_types);
+
+/* Call chain that passes the pointer by value through every layer. */
+template<typename TPtr, size_t TDepth>
+struct call_chain
+{
+    [[gnu::noinline]] static size_t call(TPtr ptr) { return call_chain<TPtr, TDepth - 1>::call(ptr); }
+};
+
+template<typename TPtr>
+struct call_chain<TPtr, 0>
+{
+    [[gnu::noinline]] static size_t call(TPtr ptr) { return ++ptr->counter; }
+};
+
+using pass_types = testing::Types<::wstux::intrusive_ptr<base_atomic_counter>,
+                                  ::wstux::borrowed_ptr<base_atomic_counter>>;
+PERF_FIXTURE_SUITE(pass_fixture, pass_types);
+
+typedef ::wstux::intrusive_ptr<base_atomic_counter> handle_ptr;
+
+/* Copies and destroys the handles one by one. */
+struct single_copier
+{
+    static void copy(const handle_ptr* first, size_t count, handle_ptr* result)
+    {
+        std::uninitialized_copy_n(first, count, result);
+    }
+
+    static void destroy(handle_ptr* first, size_t count) { std::destroy_n(first, count); }
+};
+
+/* Merges the consecutive equal handles into one counter operation. */
+struct batched_copier
+{
+    static void copy(const handle_ptr* first, size_t count, handle_ptr* result)
+    {
+        ::wstux::uninitialized_copy_n(first, count, result);
+    }
+
+    static void destroy(handle_ptr* first, size_t count) { ::wstux::destroy_n(first, count); }
+};
+
+using range_types = testing::Types<single_copier, batched_copier>;
+PERF_FIXTURE_SUITE(range_fixture, range_types);
+
+/* Small node of a syntax tree. */
+template<typename TPolicy>
+class ast_node : public ::wstux::intrusive_ref_counter<ast_node<TPolicy>, TPolicy>
+{
+public:
+    uint32_t fields[5] = {};
+};
+
+using footprint_types = testing::Types<
+    ast_node<::wstux::relaxed_atomic_counter_policy<size_t>>,
+    ast_node<::wstux::checked_atomic_counter_policy<uint32_t, ::wstux::abort_on_overflow>>,
+    ast_node<::wstux::checked_atomic_counter_policy<uint16_t, ::wstux::spill_on_overflow>>,
+    ast_node<::wstux::checked_counter_policy<uint16_t, ::wstux::saturate_on_overflow>>>;
+PERF_FIXTURE_SUITE(footprint_fixture, footprint_types);
+
+/* Document that is copied defensively and rarely changed. */
+class document : public ::wstux::intrusive_ref_counter<document>
+{
+public:
+    std::string title = std::string(64, 't');
+    std::vector<std::string> lines = std::vector<std::string>(16, std::string(64, 'l'));
+};
+
+/* Makes a deep copy of every document. */
+struct deep_copy_holder
+{
+    typedef ::wstux::intrusive_ptr<document> holder_type;
+
+    static holder_type copy(const holder_type& doc) { return ::wstux::make_intrusive<document>(*doc); }
+
+    static void change(holder_type& doc) { doc->title[0] = 'c'; }
+};
+
+/* Shares the document until it is changed. */
+struct cow_holder
+{
+    typedef ::wstux::cow_ptr<document> holder_type;
+
+    static holder_type copy(const holder_type& doc) { return doc; }
+
+    static void change(holder_type& doc) { doc.write()->title[0] = 'c'; }
+};
+
+using cow_types = testing::Types<deep_copy_holder, cow_holder>;
+PERF_FIXTURE_SUITE(cow_fixture, cow_types);
+
+/* Message whose fields are handed out as separate handles. */
+struct message_fields
+{
+    uint64_t fields[4] = {};
+};
+
+class counted_message : public message_fields
+                      , public ::wstux::intrusive_ref_counter<counted_message>
+{};
+
+/* Hands out the fields with the aliasing constructor of shared_ptr. */
+struct shared_field_accessor
+{
+    typedef std::shared_ptr<message_fields> message_type;
+    typedef std::shared_ptr<const uint64_t> field_type;
+
+    static message_type create() { return std::make_shared<message_fields>(); }
+
+    static field_type field(const message_type& p_msg, size_t i) { return field_type(p_msg, &p_msg->fields[i]); }
+};
+
+/* Hands out the fields with the aliasing pointer. */
+struct intrusive_field_accessor
+{
+    typedef ::wstux::intrusive_ptr<counted_message> message_type;
+    typedef ::wstux::aliasing_ptr<const uint64_t> field_type;
+
+    static message_type create() { return ::wstux::make_intrusive<counted_message>(); }
+
+    static field_type field(const message_type& p_msg, size_t i) { return field_type(p_msg, &p_msg->fields[i]); }
+};
+
+using alias_types = testing::Types<shared_field_accessor, intrusive_field_accessor>;
+PERF_FIXTURE_SUITE(alias_fixture, alias_types);
+
+/* Message passed between the stages of a pipeline. */
+class pipeline_message : public ::wstux::intrusive_ref_counter<pipeline_message>
+                       , public ::wstux::queue_hook<>
+{
+public:
+    size_t counter = 0;
+};
+
+typedef ::wstux::intrusive_ptr<pipeline_message> pipeline_ptr;
+
+/* Queue of the pointers under a mutex. */
+struct locked_pipeline
+{
+    void push(pipeline_ptr&& ptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push(std::move(ptr));
+    }
+
+    pipeline_ptr pop()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.empty()) {
+            return pipeline_ptr();
+        }
+        pipeline_ptr ptr = std::move(m_queue.front());
+        m_queue.pop();
+        return ptr;
+    }
+
+    std::mutex m_mutex;
+    std::queue<pipeline_ptr> m_queue;
+};
+
+struct mpsc_pipeline
+{
+    void push(pipeline_ptr&& ptr) { m_queue.push(std::move(ptr)); }
+
+    pipeline_ptr pop() { return m_queue.pop(); }
+
+    ::wstux::mpsc_queue<pipeline_message> m_queue;
+};
+
+struct mpmc_pipeline
+{
+    void push(pipeline_ptr&& ptr)
+    {
+        while (! m_ring.try_push(std::move(ptr))) {
+            std::this_thread::yield();
+        }
+    }
+
+    pipeline_ptr pop()
+    {
+        pipeline_ptr ptr;
+        m_ring.try_pop(ptr);
+        return ptr;
+    }
+
+    ::wstux::mpmc_ring<pipeline_message> m_ring{1024};
+};
+
+using pipeline_types = testing::Types<locked_pipeline, mpsc_pipeline, mpmc_pipeline>;
+PERF_FIXTURE_SUITE(pipeline_fixture, pipeline_types);
+
+/* Entry of a connection table. */
+class table_entry : public ::wstux::intrusive_ref_counter<table_entry>
+                  , public ::wstux::list_hook<>
+                  , public ::wstux::set_hook<>
+{
+public:
+    explicit table_entry(uint64_t k)
+        : key(k)
+    {}
+
+    uint64_t key;
+};
+
+typedef ::wstux::intrusive_ptr<table_entry> entry_ptr;
+
+/* Separate nodes of the standard containers. */
+struct std_table
+{
+    void insert(entry_ptr ptr)
+    {
+        m_map.emplace(ptr->key, ptr);
+        m_list.push_back(std::move(ptr));
+    }
+
+    const table_entry* find(uint64_t key) const
+    {
+        std::unordered_map<uint64_t, entry_ptr>::const_iterator it = m_map.find(key);
+        return (it != m_map.end()) ? it->second.get() : NULL;
+    }
+
+    uint64_t scan() const
+    {
+        uint64_t sum = 0;
+        for (const entry_ptr& ptr : m_list) {
+            sum += ptr->key;
+        }
+        return sum;
+    }
+
+    std::list<entry_ptr> m_list;
+    std::unordered_map<uint64_t, entry_ptr> m_map;
+};
+
+/* Links of the entries themselves. */
+struct intrusive_table
+{
+    void insert(entry_ptr ptr)
+    {
+        m_set.insert(ptr);
+        m_list.push_back(std::move(ptr));
+    }
+
+    const table_entry* find(uint64_t key) const { return m_set.find(key); }
+
+    uint64_t scan() const
+    {
+        uint64_t sum = 0;
+        for (const table_entry& entry : m_list) {
+            sum += entry.key;
+        }
+        return sum;
+    }
+
+    ::wstux::intrusive_list<table_entry> m_list;
+    ::wstux::intrusive_hash_set<table_entry, uint64_t> m_set{1 << 17};
+};
+
+using table_types = testing::Types<std_table, intrusive_table>;
+PERF_FIXTURE_SUITE(table_fixture, table_types);
+
+typedef ::wstux::intrusive_ptr<base_atomic_counter> registry_ptr;
+
+/* Registry under a mutex. */
+struct locked_registry
+{
+    void insert(uint64_t id, registry_ptr ptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_map.emplace(id, std::move(ptr));
+    }
+
+    registry_ptr find(uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<uint64_t, registry_ptr>::const_iterator it = m_map.find(id);
+        return (it != m_map.end()) ? it->second : registry_ptr();
+    }
+
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, registry_ptr> m_map;
+};
+
+/* Registry with the lock-free readers. */
+struct concurrent_registry
+{
+    void insert(uint64_t id, registry_ptr ptr) { m_map.insert(id, std::move(ptr)); }
+
+    registry_ptr find(uint64_t id) { return m_map.find(id); }
+
+    ::wstux::concurrent_hash_map<uint64_t, base_atomic_counter> m_map;
+};
+
+using registry_types = testing::Types<locked_registry, concurrent_registry>;
+PERF_FIXTURE_SUITE(registry_fixture, registry_types);
+
+/* LRU cache under a mutex, every hit moves the node to the front. */
+struct locked_lru_cache
+{
+    typedef std::list<std::pair<uint64_t, registry_ptr>> list_type;
+
+    explicit locked_lru_cache(size_t capacity)
+        : m_capacity(capacity)
+    {}
+
+    void insert(uint64_t id, registry_ptr ptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_index.find(id) != m_index.end()) {
+            return;
+        }
+        if (m_list.size() == m_capacity) {
+            m_index.erase(m_list.back().first);
+            m_list.pop_back();
+        }
+        m_list.emplace_front(id, std::move(ptr));
+        m_index.emplace(id, m_list.begin());
+    }
+
+    registry_ptr find(uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<uint64_t, list_type::iterator>::iterator it = m_index.find(id);
+        if (it == m_index.end()) {
+            return registry_ptr();
+        }
+        m_list.splice(m_list.begin(), m_list, it->second);
+        return it->second->second;
+    }
+
+    const size_t m_capacity;
+    std::mutex m_mutex;
+    list_type m_list;
+    std::unordered_map<uint64_t, list_type::iterator> m_index;
+};
+
+/* Cache with the lock-free hits. */
+struct clock_registry_cache
+{
+    explicit clock_registry_cache(size_t capacity)
+        : m_cache(capacity)
+    {}
+
+    void insert(uint64_t id, registry_ptr ptr) { m_cache.insert(id, std::move(ptr)); }
+
+    registry_ptr find(uint64_t id) { return m_cache.find(id); }
+
+    ::wstux::clock_cache<uint64_t, base_atomic_counter> m_cache;
+};
+
+using cache_types = testing::Types<locked_lru_cache, clock_registry_cache>;
+PERF_FIXTURE_SUITE(cache_fixture, cache_types);
 
 }
 
@@ -70,13 +691,12 @@ TYPED_PERF_TEST(intrusive_fixture, create_new)
     PERF_INIT_TIMER(create_new_perf);
 
     using smart_ptr = TypeParam;
-    using element_type = typename smart_ptr::element_type;
 
     size_t dummy = 0;
     const double begin = ::testing::utils::cpu_time_msecs_self();
     PERF_START_TIMER(create_new_perf);
     for (size_t i = 0; i < kIterationCount; ++i) {
-        smart_ptr ptr(new element_type());
+        smart_ptr ptr = create<smart_ptr>();
         dummy += ++ptr->counter;
     }
     PERF_PAUSE_TIMER(create_new_perf);
@@ -85,6 +705,494 @@ TYPED_PERF_TEST(intrusive_fixture, create_new)
                    << "cpu time: " << (end - begin) << " msecs";
 }
 
+TYPED_PERF_TEST(intrusive_fixture, copy)
+{
+    PERF_INIT_TIMER(copy_perf);
+
+    using smart_ptr = TypeParam;
+
+    smart_ptr ptr = create<smart_ptr>();
+    size_t dummy = 0;
+    const double begin = ::testing::utils::cpu_time_msecs_self();
+    PERF_START_TIMER(copy_perf);
+    for (size_t i = 0; i < kIterationCount; ++i) {
+        smart_ptr copy(ptr);
+        dummy += ++copy->counter;
+    }
+    PERF_PAUSE_TIMER(copy_perf);
+    const double end = ::testing::utils::cpu_time_msecs_self();
+    PERF_MESSAGE() << "iteration count: " << dummy << "; "
+                   << "cpu time: " << (end - begin) << " msecs";
+}
+
+TYPED_PERF_TEST(atomic_fixture, copy_fan_out)
+{
+    PERF_INIT_TIMER(copy_fan_out_perf);
+
+    using smart_ptr = TypeParam;
+
+    smart_ptr ptr = create<smart_ptr>();
+    std::atomic<size_t> dummy(0);
+    std::vector<std::thread> threads;
+    PERF_START_TIMER(copy_fan_out_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&ptr, &dummy]() {
+            size_t local = 0;
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                smart_ptr copy(ptr);
+                local += (copy.get() != NULL);
+            }
+            dummy += local;
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    release(ptr);
+    PERF_PAUSE_TIMER(copy_fan_out_perf);
+    PERF_MESSAGE() << "thread count: " << kThreadCount << "; "
+                   << "iteration count: " << dummy.load();
+}
+
+TYPED_PERF_TEST(atomic_fixture, copy_owner)
+{
+    PERF_INIT_TIMER(copy_owner_perf);
+
+    using smart_ptr = TypeParam;
+
+    std::atomic<size_t> dummy(0);
+    std::vector<std::thread> threads;
+    PERF_START_TIMER(copy_owner_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&dummy]() {
+            smart_ptr ptr = create<smart_ptr>();
+            size_t local = 0;
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                smart_ptr copy(ptr);
+                local += (copy.get() != NULL);
+            }
+            release(ptr);
+            dummy += local;
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    PERF_PAUSE_TIMER(copy_owner_perf);
+    PERF_MESSAGE() << "thread count: " << kThreadCount << "; "
+                   << "iteration count: " << dummy.load();
+}
+
+TYPED_PERF_TEST(publish_fixture, load_with_store)
+{
+    PERF_INIT_TIMER(load_with_store_perf);
+
+    using published_ptr = TypeParam;
+    using smart_ptr = typename published_ptr::value_type;
+    using element_type = typename smart_ptr::element_type;
+
+    static const size_t kStoreCount = kIterationCount / 100;
+
+    published_ptr published(smart_ptr(new element_type()));
+    std::atomic<size_t> dummy(0);
+    std::vector<std::thread> threads;
+    PERF_START_TIMER(load_with_store_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&published, &dummy]() {
+            size_t local = 0;
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                smart_ptr ptr = published.load();
+                local += (ptr.get() != NULL);
+            }
+            dummy += local;
+        });
+    }
+    for (size_t i = 0; i < kStoreCount; ++i) {
+        published.store(smart_ptr(new element_type()));
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    PERF_PAUSE_TIMER(load_with_store_perf);
+    PERF_MESSAGE() << "thread count: " << kThreadCount << "; "
+                   << "store count: " << kStoreCount << "; "
+                   << "iteration count: " << dummy.load();
+}
+
+TYPED_PERF_TEST(handoff_fixture, producer_consumer)
+{
+    PERF_INIT_TIMER(producer_consumer_perf);
+
+    using smart_ptr = TypeParam;
+
+    static spsc_ring<smart_ptr, 1024> ring;
+    size_t dummy = 0;
+    PERF_START_TIMER(producer_consumer_perf);
+    std::thread consumer([&dummy]() {
+        smart_ptr ptr;
+        for (size_t i = 0; i < kIterationCount; ++i) {
+            while (! ring.pop(ptr)) {
+                std::this_thread::yield();
+            }
+            dummy += ++ptr->counter;
+            ptr.reset();
+        }
+    });
+    for (size_t i = 0; i < kIterationCount; ++i) {
+        smart_ptr ptr = create<smart_ptr>();
+        while (! ring.push(ptr)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    PERF_PAUSE_TIMER(producer_consumer_perf);
+    PERF_MESSAGE() << "iteration count: " << dummy;
+}
+
+TYPED_PERF_TEST(release_fixture, release_latency)
+{
+    PERF_INIT_TIMER(release_latency_perf);
+
+    using element_type = TypeParam;
+    using smart_ptr = ::wstux::intrusive_ptr<element_type>;
+
+    static const size_t kGraphCount = 10000;
+    static const size_t kChildrenCount = 100;
+    static const size_t kDrainPeriod = 64;
+
+    std::vector<double> latencies;
+    latencies.reserve(kGraphCount);
+    for (size_t i = 0; i < kGraphCount; ++i) {
+        smart_ptr root = ::wstux::make_intrusive<element_type>();
+        for (size_t c = 0; c < kChildrenCount; ++c) {
+            root->children.push_back(::wstux::make_intrusive<element_type>());
+        }
+
+        PERF_START_TIMER(release_latency_perf);
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        root.reset();
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        PERF_PAUSE_TIMER(release_latency_perf);
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+
+        /* The reclaimer drains the queue outside of the latency-critical
+         * path. */
+        if (i % kDrainPeriod == 0) {
+            ::wstux::drain_deferred();
+        }
+    }
+    ::wstux::drain_deferred();
+
+    std::sort(latencies.begin(), latencies.end());
+    PERF_MESSAGE() << "graph count: " << kGraphCount << "; "
+                   << "p50: " << latencies[latencies.size() / 2] << " usecs; "
+                   << "p99: " << latencies[latencies.size() * 99 / 100] << " usecs; "
+                   << "p999: " << latencies[latencies.size() * 999 / 1000] << " usecs";
+}
+
+TYPED_PERF_TEST(lookup_fixture, lookup_with_store)
+{
+    PERF_INIT_TIMER(lookup_with_store_perf);
+
+    using reader = TypeParam;
+    using element_type = typename reader::element_type;
+
+    static const size_t kStoreCount = kIterationCount / 100;
+
+    ::wstux::atomic_intrusive_ptr<element_type> published(::wstux::make_intrusive<element_type>());
+    std::atomic<size_t> dummy(0);
+    std::vector<std::thread> threads;
+    PERF_START_TIMER(lookup_with_store_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&published, &dummy]() {
+            size_t local = 0;
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                local += reader::read(published);
+            }
+            dummy += local;
+        });
+    }
+    for (size_t i = 0; i < kStoreCount; ++i) {
+        published.store(::wstux::make_intrusive<element_type>());
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    PERF_PAUSE_TIMER(lookup_with_store_perf);
+    ::wstux::collect_epoch();
+    ::wstux::collect_hazard();
+    PERF_MESSAGE() << "thread count: " << kThreadCount << "; "
+                   << "store count: " << kStoreCount << "; "
+                   << "iteration count: " << dummy.load();
+}
+
+TYPED_PERF_TEST(pass_fixture, call_chain)
+{
+    PERF_INIT_TIMER(call_chain_perf);
+
+    using smart_ptr = TypeParam;
+    using element_type = typename smart_ptr::element_type;
+
+    static const size_t kDepth = 8;
+
+    ::wstux::intrusive_ptr<element_type> owner = ::wstux::make_intrusive<element_type>();
+    size_t dummy = 0;
+    PERF_START_TIMER(call_chain_perf);
+    for (size_t i = 0; i < kIterationCount; ++i) {
+        dummy += call_chain<smart_ptr, kDepth>::call(owner);
+    }
+    PERF_PAUSE_TIMER(call_chain_perf);
+    PERF_MESSAGE() << "depth: " << kDepth << "; "
+                   << "iteration count: " << kIterationCount << "; "
+                   << "dummy: " << dummy;
+}
+
+TYPED_PERF_TEST(range_fixture, copy_shared_handles)
+{
+    PERF_INIT_TIMER(copy_shared_handles_perf);
+
+    using copier = TypeParam;
+
+    static const size_t kHandleCount = 10000;
+    static const size_t kObjectCount = 4;
+    static const size_t kCopyCount = 100;
+
+    std::vector<handle_ptr> handles;
+    for (size_t i = 0; i < kObjectCount; ++i) {
+        handles.insert(handles.end(), kHandleCount / kObjectCount,
+                       ::wstux::make_intrusive<base_atomic_counter>());
+    }
+    std::vector<std::thread> threads;
+    PERF_START_TIMER(copy_shared_handles_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&handles]() {
+            std::unique_ptr<unsigned char[]> storage(new unsigned char[kHandleCount * sizeof(handle_ptr)]);
+            handle_ptr* p_copy = reinterpret_cast<handle_ptr*>(storage.get());
+            for (size_t i = 0; i < kCopyCount; ++i) {
+                copier::copy(handles.data(), handles.size(), p_copy);
+                copier::destroy(p_copy, handles.size());
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    PERF_PAUSE_TIMER(copy_shared_handles_perf);
+    PERF_MESSAGE() << "thread count: " << kThreadCount << "; "
+                   << "handle count: " << kHandleCount << "; "
+                   << "object count: " << kObjectCount << "; "
+                   << "copy count: " << kCopyCount;
+}
+
+TYPED_PERF_TEST(footprint_fixture, node_footprint)
+{
+    PERF_INIT_TIMER(node_footprint_perf);
+
+    using element_type = TypeParam;
+
+    static const size_t kNodeCount = 500000;
+
+    /* The nodes are kept until the exit, so the next case doesn't reuse the
+     * freed memory. */
+    static std::vector<::wstux::intrusive_ptr<element_type>> nodes;
+    nodes.reserve(kNodeCount);
+    const size_t mem_before = ::testing::utils::mem_usage();
+    PERF_START_TIMER(node_footprint_perf);
+    for (size_t i = 0; i < kNodeCount; ++i) {
+        nodes.push_back(::wstux::make_intrusive<element_type>());
+    }
+    PERF_PAUSE_TIMER(node_footprint_perf);
+    const size_t mem_after = ::testing::utils::mem_usage();
+    PERF_MESSAGE() << "node count: " << kNodeCount << "; "
+                   << "node size: " << sizeof(element_type) << " bytes; "
+                   << "resident growth: " << (mem_after - mem_before) << " pages";
+}
+
+TYPED_PERF_TEST(cow_fixture, copy_rarely_changed)
+{
+    PERF_INIT_TIMER(copy_rarely_changed_perf);
+
+    using holder = TypeParam;
+    using holder_type = typename holder::holder_type;
+
+    static const size_t kCopyCount = kIterationCount / 10;
+    static const size_t kChangePeriod = 100;
+
+    holder_type doc(::wstux::make_intrusive<document>());
+    size_t dummy = 0;
+    PERF_START_TIMER(copy_rarely_changed_perf);
+    for (size_t i = 0; i < kCopyCount; ++i) {
+        holder_type copy = holder::copy(doc);
+        if (i % kChangePeriod == 0) {
+            holder::change(copy);
+        }
+        dummy += copy->lines.size();
+    }
+    PERF_PAUSE_TIMER(copy_rarely_changed_perf);
+    PERF_MESSAGE() << "copy count: " << kCopyCount << "; "
+                   << "change period: " << kChangePeriod << "; "
+                   << "dummy: " << dummy;
+}
+
+TYPED_PERF_TEST(alias_fixture, message_fields)
+{
+    PERF_INIT_TIMER(message_fields_perf);
+
+    using accessor = TypeParam;
+    using field_type = typename accessor::field_type;
+
+    static const size_t kMessageCount = kIterationCount / 10;
+    static const size_t kFieldCount = 4;
+
+    std::vector<field_type> fields;
+    fields.reserve(kMessageCount * kFieldCount);
+    const size_t mem_before = ::testing::utils::mem_usage();
+    PERF_START_TIMER(message_fields_perf);
+    for (size_t i = 0; i < kMessageCount; ++i) {
+        typename accessor::message_type p_msg = accessor::create();
+        for (size_t f = 0; f < kFieldCount; ++f) {
+            fields.push_back(accessor::field(p_msg, f));
+        }
+    }
+    PERF_PAUSE_TIMER(message_fields_perf);
+    const size_t mem_after = ::testing::utils::mem_usage();
+    PERF_MESSAGE() << "message count: " << kMessageCount << "; "
+                   << "field count: " << kFieldCount << "; "
+                   << "resident growth: " << (mem_after - mem_before) << " pages";
+}
+
+TYPED_PERF_TEST(pipeline_fixture, producers_consumer)
+{
+    PERF_INIT_TIMER(producers_consumer_perf);
+
+    using pipeline = TypeParam;
+
+    static const size_t kMessageCount = kIterationCount / kThreadCount;
+
+    pipeline stage;
+    size_t dummy = 0;
+    std::vector<std::thread> producers;
+    PERF_START_TIMER(producers_consumer_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        producers.emplace_back([&stage]() {
+            for (size_t i = 0; i < kMessageCount; ++i) {
+                stage.push(::wstux::make_intrusive<pipeline_message>());
+            }
+        });
+    }
+    for (size_t count = 0; count < kMessageCount * kThreadCount;) {
+        pipeline_ptr ptr = stage.pop();
+        if (ptr) {
+            dummy += ++ptr->counter;
+            ++count;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (std::thread& t : producers) {
+        t.join();
+    }
+    PERF_PAUSE_TIMER(producers_consumer_perf);
+    PERF_MESSAGE() << "producer count: " << kThreadCount << "; "
+                   << "message count: " << dummy;
+}
+
+TYPED_PERF_TEST(table_fixture, insert_find_scan)
+{
+    PERF_INIT_TIMER(insert_find_scan_perf);
+
+    using table_type = TypeParam;
+
+    static const size_t kEntryCount = 100000;
+    static const size_t kScanCount = 20;
+
+    table_type table;
+    uint64_t dummy = 0;
+    PERF_START_TIMER(insert_find_scan_perf);
+    for (uint64_t k = 0; k < kEntryCount; ++k) {
+        table.insert(::wstux::make_intrusive<table_entry>(k * 7919));
+    }
+    for (uint64_t k = 0; k < kEntryCount; ++k) {
+        dummy += (table.find(k * 7919) != NULL);
+    }
+    for (size_t i = 0; i < kScanCount; ++i) {
+        dummy += table.scan();
+    }
+    PERF_PAUSE_TIMER(insert_find_scan_perf);
+    PERF_MESSAGE() << "entry count: " << kEntryCount << "; "
+                   << "scan count: " << kScanCount << "; "
+                   << "dummy: " << dummy;
+}
+
+TYPED_PERF_TEST(registry_fixture, concurrent_lookup)
+{
+    PERF_INIT_TIMER(concurrent_lookup_perf);
+
+    using registry_type = TypeParam;
+
+    static const uint64_t kObjectCount = 100000;
+
+    registry_type registry;
+    for (uint64_t id = 0; id < kObjectCount; ++id) {
+        registry.insert(id, ::wstux::make_intrusive<base_atomic_counter>());
+    }
+    std::atomic<size_t> found(0);
+    std::vector<std::thread> threads;
+    PERF_START_TIMER(concurrent_lookup_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&registry, &found, t]() {
+            size_t count = 0;
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                count += static_cast<bool>(registry.find((i * 7919 + t) % kObjectCount));
+            }
+            found += count;
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    PERF_PAUSE_TIMER(concurrent_lookup_perf);
+    PERF_MESSAGE() << "thread count: " << kThreadCount << "; "
+                   << "lookup count: " << found;
+}
+
+TYPED_PERF_TEST(cache_fixture, concurrent_hits)
+{
+    PERF_INIT_TIMER(concurrent_hits_perf);
+
+    using cache_type = TypeParam;
+
+    static const uint64_t kObjectCount = 20000;
+
+    /* Most of the lookups hit the hot part of the keys. */
+    cache_type cache(kObjectCount / 2);
+    std::atomic<size_t> hits(0);
+    std::vector<std::thread> threads;
+    PERF_START_TIMER(concurrent_hits_perf);
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&cache, &hits, t]() {
+            size_t count = 0;
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                const uint64_t id = (i % 16 == 0) ? (i * 7919 + t) % kObjectCount
+                                                  : (i * 7919 + t) % (kObjectCount / 4);
+                registry_ptr ptr = cache.find(id);
+                if (ptr) {
+                    ++count;
+                } else {
+                    cache.insert(id, ::wstux::make_intrusive<base_atomic_counter>());
+                }
+            }
+            hits += count;
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    PERF_PAUSE_TIMER(concurrent_hits_perf);
+    PERF_MESSAGE() << "thread count: " << kThreadCount << "; "
+                   << "hit count: " << hits;
+}
+
 int main(int /*argc*/, char** /*argv*/)
 {
     return RUN_ALL_PERF_TESTS();
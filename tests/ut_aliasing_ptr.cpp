@@ -0,0 +1,145 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/aliasing_ptr.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+struct header
+{
+    uint32_t size = 0;
+};
+
+class message : public ::wstux::intrusive_ref_counter<message>
+{
+public:
+    static size_t instance_count;
+
+    message() { ++instance_count; }
+    ~message() { --instance_count; }
+
+    header head;
+    unsigned char payload[64] = {};
+};
+
+size_t message::instance_count = 0;
+
+class buffer
+{
+    INIT_INTRUSIVE_PTR;
+
+public:
+    static size_t instance_count;
+
+    buffer() { ++instance_count; }
+    ~buffer() { --instance_count; }
+
+    size_t use_count() const { return m_ref_counter; }
+
+    unsigned char data[64] = {};
+};
+
+size_t buffer::instance_count = 0;
+
+static_assert(::wstux::is_trivially_relocatable<::wstux::aliasing_ptr<header>>::value, "");
+static_assert(std::is_nothrow_move_constructible<::wstux::aliasing_ptr<header>>::value, "");
+
+} // <anonymous> namespace
+
+TEST(aliasing_ptr, keeps_owner)
+{
+    {
+        ::wstux::intrusive_ptr<message> p_msg = ::wstux::make_intrusive<message>();
+        p_msg->head.size = 10;
+
+        ::wstux::aliasing_ptr<const header> p_head(p_msg, &p_msg->head);
+        EXPECT_TRUE(p_head.get() == &p_msg->head);
+        EXPECT_TRUE(p_head.owner() == p_msg.get());
+        EXPECT_TRUE(p_msg->use_count() == 2);
+
+        p_msg.reset();
+        EXPECT_TRUE(message::instance_count == 1);
+        EXPECT_TRUE(p_head->size == 10);
+        EXPECT_TRUE((*p_head).size == 10);
+
+        ::wstux::aliasing_ptr<const header> copy(p_head);
+        ::wstux::aliasing_ptr<const header> moved(std::move(p_head));
+        EXPECT_FALSE(p_head);
+        EXPECT_TRUE(moved == copy);
+
+        copy.reset();
+        EXPECT_TRUE(message::instance_count == 1);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+TEST(aliasing_ptr, alias_of_alias)
+{
+    {
+        ::wstux::aliasing_ptr<message> p_msg(::wstux::make_intrusive<message>());
+        ::wstux::aliasing_ptr<unsigned char> p_slice(p_msg, p_msg->payload + 16);
+        EXPECT_TRUE(p_slice.owner() == p_msg.owner());
+        EXPECT_TRUE(p_msg->use_count() == 2);
+
+        ::wstux::aliasing_ptr<const unsigned char> p_const = p_slice;
+        EXPECT_TRUE(p_const == p_slice);
+        EXPECT_TRUE(p_msg->use_count() == 3);
+
+        p_msg = ::wstux::aliasing_ptr<message>();
+        p_slice.reset();
+        EXPECT_TRUE(message::instance_count == 1);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+TEST(aliasing_ptr, macro_owner)
+{
+    {
+        ::wstux::intrusive_ptr<buffer> p_buf(new buffer);
+        ::wstux::aliasing_ptr<unsigned char> p_first(p_buf, p_buf->data);
+        ::wstux::aliasing_ptr<unsigned char> p_second(p_buf, p_buf->data + 32);
+        EXPECT_TRUE(p_buf->use_count() == 3);
+
+        std::swap(p_first, p_second);
+        EXPECT_TRUE(p_first.get() == p_buf->data + 32);
+        p_buf.reset();
+        p_first = p_second;
+        EXPECT_TRUE(buffer::instance_count == 1);
+    }
+    EXPECT_TRUE(buffer::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
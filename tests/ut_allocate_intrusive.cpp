@@ -0,0 +1,220 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/allocate_intrusive.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+/* Stateful allocator that counts the allocated units of its arena. */
+struct arena
+{
+    size_t allocated = 0;
+    size_t allocations = 0;
+};
+
+template<typename T>
+class arena_allocator
+{
+public:
+    typedef T value_type;
+
+    explicit arena_allocator(arena& a)
+        : p_arena(&a)
+    {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& rhs)
+        : p_arena(rhs.p_arena)
+    {}
+
+    T* allocate(size_t n)
+    {
+        p_arena->allocated += n;
+        ++p_arena->allocations;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        p_arena->allocated -= n;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    arena* p_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const arena_allocator<T>& lhs, const arena_allocator<U>& rhs)
+{
+    return lhs.p_arena == rhs.p_arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const arena_allocator<T>& lhs, const arena_allocator<U>& rhs)
+{
+    return lhs.p_arena != rhs.p_arena;
+}
+
+class message
+    : public ::wstux::intrusive_ref_counter<message,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::allocator_destroy_policy>
+{
+public:
+    static size_t instance_count;
+
+    explicit message(int v = 0)
+        : value(v)
+    {
+        if (v < 0) {
+            throw std::invalid_argument("negative value");
+        }
+        ++instance_count;
+    }
+    virtual ~message() { --instance_count; }
+
+    int value;
+};
+
+size_t message::instance_count = 0;
+
+class big_message : public message
+{
+public:
+    big_message()
+        : message(1)
+    {}
+
+    char payload[100] = {};
+};
+
+struct alignas(64) aligned_message
+    : public ::wstux::intrusive_ref_counter<aligned_message,
+                                           ::wstux::plain_counter_policy<uint32_t>,
+                                           ::wstux::allocator_destroy_policy>
+{
+    char payload[8];
+};
+
+class macro_message
+{
+    INIT_INTRUSIVE_PTR_WITH_DESTROY_POLICY(::wstux::allocator_destroy_policy,
+                                           ::wstux::plain_counter_policy<size_t>);
+
+public:
+    int value = 7;
+};
+
+} // <anonymous> namespace
+
+TEST(allocate_intrusive, same_allocator)
+{
+    arena a;
+    {
+        ::wstux::intrusive_ptr<message> ptr =
+            ::wstux::allocate_intrusive<message>(arena_allocator<message>(a), 5);
+        EXPECT_TRUE(ptr->value == 5);
+        EXPECT_TRUE(a.allocations == 1);
+        EXPECT_TRUE(a.allocated != 0);
+        EXPECT_TRUE(message::instance_count == 1);
+
+        ::wstux::intrusive_ptr<const message> copy(ptr);
+        ptr.reset();
+        EXPECT_TRUE(a.allocated != 0);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+    EXPECT_TRUE(a.allocated == 0);
+}
+
+TEST(allocate_intrusive, derived_through_base)
+{
+    arena a;
+    {
+        ::wstux::intrusive_ptr<message> ptr =
+            ::wstux::allocate_intrusive<big_message>(arena_allocator<char>(a));
+        EXPECT_TRUE(ptr->value == 1);
+        EXPECT_TRUE(message::instance_count == 1);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+    EXPECT_TRUE(a.allocated == 0);
+}
+
+TEST(allocate_intrusive, constructor_throws)
+{
+    arena a;
+    bool is_thrown = false;
+    try {
+        ::wstux::allocate_intrusive<message>(arena_allocator<message>(a), -1);
+    } catch (const std::invalid_argument&) {
+        is_thrown = true;
+    }
+    EXPECT_TRUE(is_thrown);
+    EXPECT_TRUE(a.allocations == 1);
+    EXPECT_TRUE(a.allocated == 0);
+}
+
+TEST(allocate_intrusive, alignment)
+{
+    arena a;
+    ::wstux::intrusive_ptr<aligned_message> ptr =
+        ::wstux::allocate_intrusive<aligned_message>(arena_allocator<aligned_message>(a));
+    EXPECT_TRUE(reinterpret_cast<uintptr_t>(ptr.get()) % 64 == 0);
+
+    ::wstux::intrusive_ptr<aligned_message> made = ::wstux::make_intrusive<aligned_message>();
+    EXPECT_TRUE(reinterpret_cast<uintptr_t>(made.get()) % 64 == 0);
+    ptr.reset();
+    EXPECT_TRUE(a.allocated == 0);
+}
+
+TEST(allocate_intrusive, make_intrusive)
+{
+    {
+        ::wstux::intrusive_ptr<message> ptr = ::wstux::make_intrusive<message>(3);
+        EXPECT_TRUE(ptr->value == 3);
+
+        ::wstux::intrusive_ptr<macro_message> macro_ptr = ::wstux::make_intrusive<macro_message>();
+        EXPECT_TRUE(macro_ptr->value == 7);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+
+    arena a;
+    ::wstux::intrusive_ptr<macro_message> ptr =
+        ::wstux::allocate_intrusive<macro_message>(arena_allocator<char>(a));
+    ptr.reset();
+    EXPECT_TRUE(a.allocations == 1);
+    EXPECT_TRUE(a.allocated == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,192 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#ifdef __unix__
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <testing/testdefs.h>
+
+#include "intrusive/atomic_intrusive_ptr.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+class object : public ::wstux::intrusive_ref_counter<object>
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    explicit object(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~object() { --instance_count; }
+
+    size_t value;
+};
+
+std::atomic<size_t> object::instance_count(0);
+
+typedef ::wstux::intrusive_ptr<object> object_ptr;
+
+#ifdef __unix__
+/* Runs the function in the child process, returns true if it aborts. */
+template<typename TFunc>
+bool is_aborted(TFunc func)
+{
+    const pid_t pid = ::fork();
+    if (pid == 0) {
+        func();
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return (WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+}
+#endif
+
+} // <anonymous> namespace
+
+TEST(atomic_intrusive_ptr, load_store)
+{
+    {
+        ::wstux::atomic_intrusive_ptr<object> atomic_ptr;
+        EXPECT_TRUE(atomic_ptr.is_lock_free());
+        EXPECT_TRUE(atomic_ptr.load().get() == NULL);
+
+        object_ptr ptr(new object(1));
+        atomic_ptr.store(ptr);
+        EXPECT_TRUE(ptr->use_count() == 2);
+        {
+            object_ptr loaded = atomic_ptr.load();
+            EXPECT_TRUE(loaded == ptr);
+            EXPECT_TRUE(ptr->use_count() == 3);
+        }
+        EXPECT_TRUE(ptr->use_count() == 2);
+
+        atomic_ptr = object_ptr(new object(2));
+        EXPECT_TRUE(ptr->use_count() == 1);
+        EXPECT_TRUE(object_ptr(atomic_ptr)->value == 2);
+        EXPECT_TRUE(object::instance_count == 2);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(atomic_intrusive_ptr, exchange)
+{
+    {
+        ::wstux::atomic_intrusive_ptr<object> atomic_ptr(object_ptr(new object(1)));
+        object_ptr old = atomic_ptr.exchange(object_ptr(new object(2)));
+        ASSERT_TRUE(old.get() != NULL);
+        EXPECT_TRUE(old->value == 1);
+        EXPECT_TRUE(old->use_count() == 1);
+
+        old = atomic_ptr.exchange(object_ptr());
+        EXPECT_TRUE(old->value == 2);
+        EXPECT_TRUE(atomic_ptr.load().get() == NULL);
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(atomic_intrusive_ptr, compare_exchange)
+{
+    {
+        object_ptr first(new object(1));
+        object_ptr second(new object(2));
+        ::wstux::atomic_intrusive_ptr<object> atomic_ptr(first);
+
+        object_ptr expected = second;
+        EXPECT_FALSE(atomic_ptr.compare_exchange_strong(expected, second));
+        EXPECT_TRUE(expected == first);
+
+        EXPECT_TRUE(atomic_ptr.compare_exchange_strong(expected, second));
+        EXPECT_TRUE(atomic_ptr.load() == second);
+        EXPECT_TRUE(first->use_count() == 2);
+        EXPECT_TRUE(second->use_count() == 2);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(atomic_intrusive_ptr, concurrent_load_store)
+{
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 10000;
+
+    {
+        ::wstux::atomic_intrusive_ptr<object> atomic_ptr(object_ptr(new object(0)));
+        std::atomic<bool> is_bad(false);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&atomic_ptr, &is_bad]() {
+                size_t last = 0;
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    object_ptr ptr = atomic_ptr.load();
+                    if (ptr->value < last) {
+                        is_bad = true;
+                    }
+                    last = ptr->value;
+                }
+            });
+        }
+        for (size_t i = 1; i <= kIterationCount; ++i) {
+            if (i % 2 == 0) {
+                atomic_ptr.store(object_ptr(new object(i)));
+            } else {
+                object_ptr expected = atomic_ptr.load();
+                atomic_ptr.compare_exchange_strong(expected, object_ptr(new object(i)));
+            }
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        EXPECT_FALSE(is_bad);
+        EXPECT_TRUE(atomic_ptr.load()->value == kIterationCount);
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+#ifdef __unix__
+TEST(atomic_intrusive_ptr, wide_pointer)
+{
+    /* The pointer above 48 bits would become the count of the readers. */
+    const uintptr_t wide = (uintptr_t(1) << 56) | 0x1000;
+    EXPECT_TRUE(is_aborted([wide]() { ::wstux::details::split_ptr_word::pack(reinterpret_cast<void*>(wide)); }));
+    EXPECT_FALSE(is_aborted([]() { ::wstux::details::split_ptr_word::pack(reinterpret_cast<void*>(0x1000)); }));
+}
+#endif
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,168 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define INTRUSIVE_CHECK_BORROWS
+
+#if ! defined(NDEBUG) && defined(__unix__)
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <testing/testdefs.h>
+
+#include "intrusive/borrowed_ptr.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+class base : public ::wstux::intrusive_ref_counter<base>
+{
+public:
+    virtual ~base() = default;
+
+    size_t value = 1;
+};
+
+class derived : public base
+{};
+
+typedef ::wstux::intrusive_ptr<base> base_ptr;
+typedef ::wstux::borrowed_ptr<base> borrowed_base;
+
+size_t borrow_count(const base* p)
+{
+    return ::wstux::details::borrow_registry::instance().count(p);
+}
+
+size_t leaf(borrowed_base p) { return p->value; }
+
+size_t middle(borrowed_base p) { return leaf(p) + leaf(p); }
+
+#if ! defined(NDEBUG) && defined(__unix__)
+/* Runs the function in the child process, returns true if it aborts. */
+template<typename TFunc>
+bool is_aborted(TFunc func)
+{
+    const pid_t pid = ::fork();
+    if (pid == 0) {
+        func();
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return (WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+}
+#endif
+
+} // <anonymous> namespace
+
+TEST(borrowed_ptr, borrow)
+{
+    base_ptr owner = ::wstux::make_intrusive<base>();
+    {
+        borrowed_base p = owner;
+        EXPECT_TRUE(p == owner);
+        EXPECT_TRUE(p.get() == owner.get());
+        EXPECT_TRUE(owner->use_count() == 1);
+        EXPECT_TRUE(borrow_count(owner.get()) == 1);
+
+        EXPECT_TRUE(middle(p) == 2);
+        EXPECT_TRUE(middle(owner) == 2);
+        EXPECT_TRUE(owner->use_count() == 1);
+        EXPECT_TRUE(borrow_count(owner.get()) == 1);
+    }
+    EXPECT_TRUE(borrow_count(owner.get()) == 0);
+}
+
+TEST(borrowed_ptr, empty)
+{
+    borrowed_base p;
+    EXPECT_FALSE(p);
+    EXPECT_TRUE(! p);
+    EXPECT_FALSE(p.promote());
+
+    base_ptr owner;
+    borrowed_base p_owner = owner;
+    EXPECT_TRUE(p_owner == p);
+}
+
+TEST(borrowed_ptr, convert)
+{
+    ::wstux::intrusive_ptr<derived> owner = ::wstux::make_intrusive<derived>();
+    ::wstux::borrowed_ptr<derived> p_derived = owner;
+    borrowed_base p_base = p_derived;
+    ::wstux::borrowed_ptr<const base> p_const = p_base;
+    EXPECT_TRUE(p_const == owner);
+    EXPECT_TRUE(borrow_count(owner.get()) == 3);
+}
+
+TEST(borrowed_ptr, assign)
+{
+    base_ptr owner_1 = ::wstux::make_intrusive<base>();
+    base_ptr owner_2 = ::wstux::make_intrusive<base>();
+    borrowed_base p_1 = owner_1;
+    borrowed_base p_2 = owner_2;
+    p_1 = p_2;
+    EXPECT_TRUE(borrow_count(owner_1.get()) == 0);
+    EXPECT_TRUE(borrow_count(owner_2.get()) == 2);
+}
+
+TEST(borrowed_ptr, promote)
+{
+    base_ptr kept;
+    {
+        base_ptr owner = ::wstux::make_intrusive<base>();
+        borrowed_base p = owner;
+        kept = p.promote();
+        EXPECT_TRUE(owner->use_count() == 2);
+    }
+    EXPECT_TRUE(kept->use_count() == 1);
+    EXPECT_TRUE(borrow_count(kept.get()) == 0);
+}
+
+#if ! defined(NDEBUG) && defined(__unix__)
+TEST(borrowed_ptr, outlives_owner)
+{
+    EXPECT_TRUE(is_aborted([]() {
+        base_ptr owner = ::wstux::make_intrusive<base>();
+        borrowed_base p = owner;
+        /* The last reference is released while the object is borrowed. */
+        owner.reset();
+    }));
+    EXPECT_FALSE(is_aborted([]() {
+        base_ptr owner = ::wstux::make_intrusive<base>();
+        {
+            borrowed_base p = owner;
+        }
+        owner.reset();
+    }));
+}
+#endif
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,180 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/checked_counter.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+template<typename TPolicy>
+class node : public ::wstux::intrusive_ref_counter<node<TPolicy>, TPolicy>
+{
+public:
+    static size_t instance_count;
+
+    node() { ++instance_count; }
+    ~node() { --instance_count; }
+
+    uint16_t kind = 0;
+};
+
+template<typename TPolicy>
+size_t node<TPolicy>::instance_count = 0;
+
+class macro_node
+{
+    INIT_INTRUSIVE_PTR_WITH_POLICY(::wstux::checked_counter_policy<uint16_t>);
+
+public:
+    uint16_t kind = 0;
+};
+
+template<typename T>
+class checked_fixture : public ::testing::Test
+{
+public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+using types = testing::Types<::wstux::checked_counter_policy<uint16_t, ::wstux::spill_on_overflow>,
+                             ::wstux::checked_atomic_counter_policy<uint16_t, ::wstux::spill_on_overflow>>;
+TYPED_TEST_SUITE(checked_fixture, types);
+
+} // <anonymous> namespace
+
+TEST(checked_counter, footprint)
+{
+    EXPECT_TRUE(sizeof(macro_node) == 4);
+    EXPECT_TRUE(sizeof(node<::wstux::checked_atomic_counter_policy<uint16_t>>) == 4);
+    EXPECT_TRUE(sizeof(::wstux::basic_ref_counter<::wstux::checked_atomic_counter_policy<uint32_t>>) == 4);
+}
+
+TYPED_TEST(checked_fixture, spill)
+{
+    using object = node<TypeParam>;
+    static const size_t kCount = 70000;
+
+    {
+        ::wstux::intrusive_ptr<object> ptr(new object);
+        std::vector<::wstux::intrusive_ptr<object>> copies(kCount, ptr);
+        EXPECT_TRUE(ptr->use_count() == 65535);
+
+        copies.resize(kCount / 2);
+        copies.clear();
+        EXPECT_TRUE(ptr->use_count() == 1);
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TYPED_TEST(checked_fixture, batched_spill)
+{
+    using object = node<TypeParam>;
+    static const size_t kCount = 70000;
+
+    {
+        ::wstux::intrusive_ptr<object> ptr(new object);
+        ::wstux::details::add_ref_n(ptr.get(), kCount);
+        EXPECT_TRUE(ptr->use_count() == 65535);
+
+        /* The spilled references are released first. */
+        ::wstux::details::release_n(ptr.get(), kCount / 2);
+        EXPECT_TRUE(ptr->use_count() == kCount / 2 + 1);
+        ::wstux::details::release_n(ptr.get(), kCount - kCount / 2);
+        EXPECT_TRUE(ptr->use_count() == 1);
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(checked_counter, oversized_batch)
+{
+    using object = node<::wstux::checked_counter_policy<uint32_t, ::wstux::spill_on_overflow>>;
+    /* The batch is wider than the counter value. */
+    static const size_t kCount = (size_t(1) << 32) + 1;
+
+    {
+        ::wstux::intrusive_ptr<object> ptr(new object);
+        ::wstux::details::add_ref_n(ptr.get(), kCount);
+        EXPECT_TRUE(ptr->use_count() == 0xffffffff);
+
+        ::wstux::details::release_n(ptr.get(), kCount);
+        EXPECT_TRUE(ptr->use_count() == 1);
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(checked_counter, saturate)
+{
+    using object = node<::wstux::checked_atomic_counter_policy<uint16_t, ::wstux::saturate_on_overflow>>;
+
+    object* p_object = NULL;
+    {
+        ::wstux::intrusive_ptr<object> ptr(new object);
+        p_object = ptr.get();
+        std::vector<::wstux::intrusive_ptr<object>> copies(65535, ptr);
+        EXPECT_TRUE(ptr->use_count() == 65535);
+    }
+    /* The saturated object is leaked. */
+    EXPECT_TRUE(object::instance_count == 1);
+    delete p_object;
+}
+
+TEST(checked_counter, concurrent_spill)
+{
+    using object = node<::wstux::checked_atomic_counter_policy<uint16_t, ::wstux::spill_on_overflow>>;
+    static const size_t kThreadCount = 4;
+    static const size_t kCount = 20000;
+
+    {
+        ::wstux::intrusive_ptr<object> ptr(new object);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&ptr]() {
+                for (size_t r = 0; r < 4; ++r) {
+                    std::vector<::wstux::intrusive_ptr<object>> copies(kCount, ptr);
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        EXPECT_TRUE(ptr->use_count() == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,243 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/clock_cache.h"
+#include "intrusive/epoch.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+/* Counts the allocations of the global operator new or makes it fail. */
+std::atomic<size_t> alloc_count(0);
+bool is_alloc_failed = false;
+
+} // <anonymous> namespace
+
+void* operator new(size_t size)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    void* p = is_alloc_failed ? NULL : std::malloc(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t /*size*/) noexcept { std::free(p); }
+
+namespace {
+
+class image : public ::wstux::intrusive_ref_counter<image>
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    explicit image(uint64_t i)
+        : id(i)
+    { ++instance_count; }
+    ~image() { --instance_count; }
+
+    const uint64_t id;
+};
+
+std::atomic<size_t> image::instance_count(0);
+
+typedef ::wstux::intrusive_ptr<image> image_ptr;
+typedef ::wstux::clock_cache<uint64_t, image, std::hash<uint64_t>, std::equal_to<uint64_t>, 1> single_cache_type;
+typedef ::wstux::clock_cache<uint64_t, image> cache_type;
+
+/* Every call may advance the epoch by one. */
+void collect_all()
+{
+    for (size_t i = 0; i < 4; ++i) {
+        ::wstux::collect_epoch();
+    }
+}
+
+} // <anonymous> namespace
+
+TEST(clock_cache, insert_find_erase)
+{
+    {
+        single_cache_type cache(4);
+        EXPECT_TRUE(cache.empty());
+        EXPECT_TRUE(cache.capacity() == 4);
+        EXPECT_FALSE(cache.find(1));
+
+        image_ptr ptr(new image(1));
+        EXPECT_TRUE(cache.insert(1, ptr));
+        EXPECT_FALSE(cache.insert(1, image_ptr(new image(1))));
+        EXPECT_TRUE(cache.find(1) == ptr);
+        EXPECT_TRUE(cache.size() == 1);
+
+        cache.insert_or_assign(1, image_ptr(new image(2)));
+        EXPECT_TRUE(cache.find(1)->id == 2);
+        EXPECT_TRUE(cache.size() == 1);
+
+        EXPECT_TRUE(cache.erase(1)->id == 2);
+        EXPECT_FALSE(cache.contains(1));
+        EXPECT_FALSE(cache.erase(1));
+        EXPECT_TRUE(cache.empty());
+    }
+    collect_all();
+    EXPECT_TRUE(image::instance_count == 0);
+}
+
+TEST(clock_cache, second_chance)
+{
+    {
+        single_cache_type cache(3);
+        for (uint64_t id = 0; id < 3; ++id) {
+            cache.insert(id, image_ptr(new image(id)));
+        }
+        /* The referenced entries survive the sweep. */
+        EXPECT_TRUE(cache.find(0));
+        EXPECT_TRUE(cache.find(2));
+        cache.insert(3, image_ptr(new image(3)));
+        EXPECT_TRUE(cache.size() == 3);
+        EXPECT_TRUE(cache.contains(0));
+        EXPECT_FALSE(cache.contains(1));
+        EXPECT_TRUE(cache.contains(2));
+        EXPECT_TRUE(cache.contains(3));
+
+        /* The bits have been cleared by the sweep. */
+        cache.insert(4, image_ptr(new image(4)));
+        EXPECT_FALSE(cache.contains(0));
+        EXPECT_TRUE(cache.contains(4));
+    }
+    collect_all();
+    EXPECT_TRUE(image::instance_count == 0);
+}
+
+TEST(clock_cache, eviction_keeps_users)
+{
+    {
+        single_cache_type cache(1);
+        cache.insert(1, image_ptr(new image(1)));
+        image_ptr ptr = cache.find(1);
+
+        cache.insert(2, image_ptr(new image(2)));
+        cache.insert(3, image_ptr(new image(3)));
+        EXPECT_FALSE(cache.contains(1));
+        collect_all();
+        EXPECT_TRUE(image::instance_count == 2);
+        EXPECT_TRUE(ptr->id == 1);
+        EXPECT_TRUE(ptr->use_count() == 1);
+    }
+    collect_all();
+    EXPECT_TRUE(image::instance_count == 0);
+}
+
+TEST(clock_cache, eviction_allocates_node)
+{
+    {
+        single_cache_type cache(2);
+        cache.insert(1, image_ptr(new image(1)));
+        cache.insert(2, image_ptr(new image(2)));
+        image_ptr ptr_3(new image(3));
+        image_ptr ptr_4(new image(4));
+        ::wstux::collect_epoch();
+
+        /* The evicted entry is retired by its embedded link. */
+        alloc_count = 0;
+        EXPECT_TRUE(cache.insert(3, ptr_3));
+        EXPECT_TRUE(alloc_count == 1);
+        EXPECT_TRUE(cache.size() == 2);
+
+        alloc_count = 0;
+        cache.insert_or_assign(3, ptr_4);
+        EXPECT_TRUE(alloc_count == 1);
+
+        alloc_count = 0;
+        EXPECT_TRUE(cache.erase(3) == ptr_4);
+        EXPECT_TRUE(alloc_count == 0);
+
+        /* The failed insertion evicts nothing. */
+        EXPECT_TRUE(cache.insert(3, ptr_3));
+        is_alloc_failed = true;
+        EXPECT_THROW(cache.insert(4, ptr_4), std::bad_alloc);
+        is_alloc_failed = false;
+        EXPECT_TRUE(cache.size() == 2);
+        EXPECT_TRUE(cache.contains(3));
+        EXPECT_FALSE(cache.contains(4));
+        /* The erased entry holds its reference until it is collected. */
+        collect_all();
+        EXPECT_TRUE(ptr_4->use_count() == 1);
+    }
+    collect_all();
+    EXPECT_TRUE(image::instance_count == 0);
+}
+
+TEST(clock_cache, concurrent_hits)
+{
+    static const size_t kThreadCount = 4;
+    static const uint64_t kObjectCount = 256;
+    static const size_t kIterationCount = 20000;
+
+    {
+        cache_type cache(kObjectCount / 2);
+        std::atomic<bool> is_bad(false);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&cache, &is_bad, t]() {
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    const uint64_t id = (i * 31 + t) % kObjectCount;
+                    image_ptr ptr = cache.find(id);
+                    if (! ptr) {
+                        ptr = image_ptr(new image(id));
+                        cache.insert(id, ptr);
+                    }
+                    if (ptr->id != id) {
+                        is_bad = true;
+                    }
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        EXPECT_FALSE(is_bad);
+        EXPECT_TRUE(cache.size() <= cache.capacity());
+    }
+    collect_all();
+    EXPECT_TRUE(image::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
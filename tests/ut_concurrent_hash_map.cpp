@@ -0,0 +1,220 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/concurrent_hash_map.h"
+#include "intrusive/epoch.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+/* Makes the global operator new fail, the removal must not allocate. */
+bool is_alloc_failed = false;
+
+} // <anonymous> namespace
+
+void* operator new(size_t size)
+{
+    void* p = is_alloc_failed ? NULL : std::malloc(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t /*size*/) noexcept { std::free(p); }
+
+namespace {
+
+class session : public ::wstux::intrusive_ref_counter<session>
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    explicit session(uint64_t i)
+        : id(i)
+    { ++instance_count; }
+    ~session() { --instance_count; }
+
+    const uint64_t id;
+};
+
+std::atomic<size_t> session::instance_count(0);
+
+typedef ::wstux::intrusive_ptr<session> session_ptr;
+typedef ::wstux::concurrent_hash_map<uint64_t, session> registry_type;
+
+/* Every call may advance the epoch by one. */
+void collect_all()
+{
+    for (size_t i = 0; i < 4; ++i) {
+        ::wstux::collect_epoch();
+    }
+}
+
+} // <anonymous> namespace
+
+TEST(concurrent_hash_map, insert_find_erase)
+{
+    {
+        registry_type registry;
+        EXPECT_TRUE(registry.empty());
+        EXPECT_FALSE(registry.find(1));
+
+        session_ptr ptr(new session(1));
+        EXPECT_TRUE(registry.insert(1, ptr));
+        EXPECT_FALSE(registry.insert(1, session_ptr(new session(1))));
+        EXPECT_TRUE(ptr->use_count() == 2);
+        EXPECT_TRUE(registry.find(1) == ptr);
+        EXPECT_TRUE(registry.contains(1));
+        EXPECT_TRUE(registry.size() == 1);
+
+        registry.insert_or_assign(1, session_ptr(new session(2)));
+        EXPECT_TRUE(registry.find(1)->id == 2);
+        EXPECT_TRUE(registry.size() == 1);
+
+        session_ptr removed = registry.erase(1);
+        EXPECT_TRUE(removed->id == 2);
+        EXPECT_FALSE(registry.erase(1));
+        EXPECT_TRUE(registry.empty());
+        removed.reset();
+
+        /* The removed entries keep their values until they are reclaimed. */
+        collect_all();
+        EXPECT_TRUE(ptr->use_count() == 1);
+        EXPECT_TRUE(session::instance_count == 1);
+    }
+    collect_all();
+    EXPECT_TRUE(session::instance_count == 0);
+}
+
+TEST(concurrent_hash_map, grow)
+{
+    static const uint64_t kCount = 10000;
+
+    {
+        registry_type registry;
+        for (uint64_t id = 0; id < kCount; ++id) {
+            registry.insert(id, session_ptr(new session(id)));
+        }
+        EXPECT_TRUE(registry.size() == kCount);
+        bool is_found = true;
+        for (uint64_t id = 0; id < kCount; ++id) {
+            session_ptr ptr = registry.find(id);
+            is_found = is_found && ptr && ptr->id == id;
+        }
+        EXPECT_TRUE(is_found);
+        collect_all();
+        EXPECT_TRUE(registry.find(kCount / 2)->use_count() == 2);
+    }
+    collect_all();
+    EXPECT_TRUE(session::instance_count == 0);
+}
+
+TEST(concurrent_hash_map, erase_without_memory)
+{
+    static const uint64_t kCount = 1000;
+
+    {
+        registry_type registry;
+        for (uint64_t id = 0; id < kCount; ++id) {
+            registry.insert(id, session_ptr(new session(id)));
+        }
+        ::wstux::collect_epoch();
+        /* The removed entries and the released values are retired by the
+         * embedded links. */
+        is_alloc_failed = true;
+        bool is_erased = true;
+        for (uint64_t id = 0; id < kCount; ++id) {
+            is_erased = is_erased && registry.erase(id);
+        }
+        is_alloc_failed = false;
+        EXPECT_TRUE(is_erased);
+        EXPECT_TRUE(registry.empty());
+    }
+    collect_all();
+    EXPECT_TRUE(session::instance_count == 0);
+}
+
+TEST(concurrent_hash_map, concurrent_readers)
+{
+    static const size_t kThreadCount = 4;
+    static const uint64_t kKeyCount = 256;
+    static const size_t kIterationCount = 20000;
+
+    {
+        registry_type registry;
+        for (uint64_t id = 0; id < kKeyCount; id += 2) {
+            registry.insert(id, session_ptr(new session(id)));
+        }
+        std::atomic<bool> is_done(false);
+        std::atomic<bool> is_bad(false);
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            readers.emplace_back([&registry, &is_done, &is_bad]() {
+                while (! is_done) {
+                    for (uint64_t id = 0; id < kKeyCount; ++id) {
+                        session_ptr ptr = registry.find(id);
+                        /* The even keys are never removed. */
+                        if ((ptr && ptr->id != id) || (id % 2 == 0 && ! ptr)) {
+                            is_bad = true;
+                        }
+                    }
+                }
+            });
+        }
+        for (size_t i = 0; i < kIterationCount; ++i) {
+            const uint64_t id = (i * 2 + 1) % kKeyCount + kKeyCount * (i % 8);
+            if (i % 3 == 0) {
+                registry.erase(id);
+            } else {
+                registry.insert_or_assign(id, session_ptr(new session(id)));
+            }
+        }
+        is_done = true;
+        for (std::thread& t : readers) {
+            t.join();
+        }
+        EXPECT_FALSE(is_bad);
+    }
+    collect_all();
+    EXPECT_TRUE(session::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,179 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/cow_ptr.h"
+#include "intrusive/immortal_counter.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/sharded_counter.h"
+
+namespace {
+
+/* Counts the deep copies. */
+class document : public ::wstux::intrusive_ref_counter<document>
+{
+public:
+    static size_t copy_count;
+
+    explicit document(const std::string& t = std::string())
+        : text(t)
+    {}
+
+    document(const document& rhs)
+        : ::wstux::intrusive_ref_counter<document>(rhs)
+        , text(rhs.text)
+    { ++copy_count; }
+
+    std::string text;
+};
+
+size_t document::copy_count = 0;
+
+class config
+{
+    INIT_INTRUSIVE_PTR;
+
+public:
+    size_t timeout = 0;
+};
+
+class immortal_config
+    : public ::wstux::intrusive_ref_counter<immortal_config, ::wstux::immortal_counter_policy<size_t>>
+{
+public:
+    size_t timeout = 0;
+};
+
+class sharded_config
+    : public ::wstux::intrusive_ref_counter<sharded_config, ::wstux::sharded_counter_policy<size_t>>
+{
+public:
+    size_t timeout = 0;
+};
+
+typedef ::wstux::cow_ptr<document> document_ptr;
+
+} // <anonymous> namespace
+
+TEST(cow_ptr, share_on_copy)
+{
+    document::copy_count = 0;
+
+    document_ptr doc = ::wstux::make_cow<document>("text");
+    EXPECT_TRUE(doc.is_unique());
+    document_ptr copy_1 = doc;
+    document_ptr copy_2 = copy_1;
+    EXPECT_FALSE(doc.is_unique());
+    EXPECT_TRUE(copy_1 == doc);
+    EXPECT_TRUE(copy_2->text == "text");
+    EXPECT_TRUE((*copy_2).text == "text");
+    EXPECT_TRUE(doc->use_count() == 3);
+    EXPECT_TRUE(document::copy_count == 0);
+}
+
+TEST(cow_ptr, clone_on_write)
+{
+    document::copy_count = 0;
+
+    document_ptr doc = ::wstux::make_cow<document>("text");
+    doc.write()->text += " 1";
+    EXPECT_TRUE(document::copy_count == 0);
+
+    document_ptr copy = doc;
+    copy.write()->text += " 2";
+    EXPECT_TRUE(document::copy_count == 1);
+    EXPECT_TRUE(copy != doc);
+    EXPECT_TRUE(doc->text == "text 1");
+    EXPECT_TRUE(copy->text == "text 1 2");
+    EXPECT_TRUE(doc.is_unique());
+    EXPECT_TRUE(copy.is_unique());
+
+    /* The clone is owned by the copy only. */
+    copy.write()->text += " 3";
+    EXPECT_TRUE(document::copy_count == 1);
+
+    ::wstux::intrusive_ptr<const document> shared = doc.share();
+    doc.write()->text = "new";
+    EXPECT_TRUE(document::copy_count == 2);
+    EXPECT_TRUE(shared->text == "text 1");
+    shared.reset();
+
+    doc.reset();
+    EXPECT_FALSE(doc);
+    EXPECT_FALSE(doc.is_unique());
+}
+
+TEST(cow_ptr, macro)
+{
+    ::wstux::cow_ptr<config> cfg = ::wstux::make_cow<config>();
+    ::wstux::cow_ptr<config> copy = cfg;
+    copy.write()->timeout = 10;
+    EXPECT_TRUE(cfg->timeout == 0);
+    EXPECT_TRUE(copy->timeout == 10);
+    EXPECT_TRUE(cfg.is_unique());
+}
+
+TEST(cow_ptr, immortal)
+{
+    ::wstux::intrusive_ptr<immortal_config> p_default = ::wstux::make_intrusive<immortal_config>();
+    ::wstux::make_immortal(p_default);
+    immortal_config* p_config = p_default.get();
+    p_default.reset();
+
+    /* The immortal object is shared, though its counter is 1. */
+    ::wstux::intrusive_ptr<immortal_config> ptr(p_config);
+    ::wstux::cow_ptr<immortal_config> cfg(std::move(ptr));
+    EXPECT_FALSE(cfg.is_unique());
+    cfg.write()->timeout = 10;
+    EXPECT_TRUE(cfg.get() != p_config);
+    EXPECT_TRUE(p_config->timeout == 0);
+    EXPECT_TRUE(cfg.is_unique());
+
+    delete p_config;
+}
+
+TEST(cow_ptr, sharded)
+{
+    ::wstux::intrusive_ptr<sharded_config> ptr = ::wstux::make_intrusive<sharded_config>();
+    const sharded_config* p_config = ptr.get();
+    ::wstux::cow_ptr<sharded_config> cfg(ptr);
+    /* The base reference is alive until the object is retired. */
+    EXPECT_FALSE(cfg.is_unique());
+
+    ::wstux::retire(ptr);
+    EXPECT_TRUE(cfg.is_unique());
+    cfg.write()->timeout = 10;
+    EXPECT_TRUE(cfg.get() == p_config);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
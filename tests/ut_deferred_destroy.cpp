@@ -0,0 +1,150 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/deferred_destroy.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+/* Makes the global operator new fail, the release must not allocate. */
+bool is_alloc_failed = false;
+
+} // <anonymous> namespace
+
+void* operator new(size_t size)
+{
+    void* p = is_alloc_failed ? NULL : std::malloc(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t /*size*/) noexcept { std::free(p); }
+
+namespace {
+
+class node
+    : public ::wstux::intrusive_ref_counter<node,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::deferred_destroy_policy<>>
+    , public ::wstux::deferred_hook
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    node() { ++instance_count; }
+    ~node() { --instance_count; }
+
+    std::vector<::wstux::intrusive_ptr<node>> children;
+};
+
+std::atomic<size_t> node::instance_count(0);
+
+::wstux::intrusive_ptr<node> make_tree(size_t children_count)
+{
+    ::wstux::intrusive_ptr<node> root = ::wstux::make_intrusive<node>();
+    for (size_t i = 0; i < children_count; ++i) {
+        root->children.push_back(::wstux::make_intrusive<node>());
+    }
+    return root;
+}
+
+} // <anonymous> namespace
+
+TEST(deferred_destroy, drain)
+{
+    ::wstux::intrusive_ptr<node> ptr = ::wstux::make_intrusive<node>();
+    ptr.reset();
+    EXPECT_TRUE(node::instance_count == 1);
+
+    EXPECT_TRUE(::wstux::drain_deferred() == 1);
+    EXPECT_TRUE(node::instance_count == 0);
+    EXPECT_TRUE(::wstux::drain_deferred() == 0);
+}
+
+TEST(deferred_destroy, cascade)
+{
+    ::wstux::intrusive_ptr<node> root = make_tree(10);
+    root.reset();
+    EXPECT_TRUE(node::instance_count == 11);
+
+    EXPECT_TRUE(::wstux::drain_deferred() == 11);
+    EXPECT_TRUE(node::instance_count == 0);
+}
+
+TEST(deferred_destroy, drain_batch)
+{
+    ::wstux::intrusive_ptr<node> root = make_tree(10);
+    root.reset();
+
+    EXPECT_TRUE(::wstux::drain_deferred(4) == 4);
+    EXPECT_TRUE(node::instance_count == 7);
+    EXPECT_TRUE(::wstux::drain_deferred(4) == 4);
+    EXPECT_TRUE(::wstux::drain_deferred() == 3);
+    EXPECT_TRUE(node::instance_count == 0);
+}
+
+TEST(deferred_destroy, release_without_memory)
+{
+    ::wstux::intrusive_ptr<node> root = make_tree(10);
+    is_alloc_failed = true;
+    root.reset();
+    const size_t count = ::wstux::drain_deferred();
+    is_alloc_failed = false;
+
+    EXPECT_TRUE(count == 11);
+    EXPECT_TRUE(node::instance_count == 0);
+}
+
+TEST(deferred_destroy, reclaimer)
+{
+    {
+        ::wstux::deferred_reclaimer reclaimer(std::chrono::milliseconds(1));
+        std::thread t([]() {
+            for (size_t i = 0; i < 100; ++i) {
+                make_tree(10);
+            }
+        });
+        t.join();
+    }
+    EXPECT_TRUE(node::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
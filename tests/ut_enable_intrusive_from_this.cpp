@@ -0,0 +1,98 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/enable_intrusive_from_this.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+class connection
+    : public ::wstux::intrusive_ref_counter<connection>
+    , public ::wstux::enable_intrusive_from_this<connection>
+{
+public:
+    static size_t instance_count;
+
+    connection() { ++instance_count; }
+    ~connection() { --instance_count; }
+
+    /* Keeps itself alive until the posted handler is run. */
+    void start(std::vector<::wstux::intrusive_ptr<connection>>& queue) { queue.push_back(intrusive_from_this()); }
+};
+
+size_t connection::instance_count = 0;
+
+class session
+    : public ::wstux::enable_intrusive_from_this<session>
+{
+    INIT_INTRUSIVE_PTR;
+
+public:
+    size_t use_count() const { return m_ref_counter; }
+};
+
+} // <anonymous> namespace
+
+TEST(enable_intrusive_from_this, empty_base)
+{
+    EXPECT_TRUE(sizeof(connection) == sizeof(::wstux::intrusive_ref_counter<connection>));
+}
+
+TEST(enable_intrusive_from_this, intrusive_from_this)
+{
+    std::vector<::wstux::intrusive_ptr<connection>> queue;
+    {
+        ::wstux::intrusive_ptr<connection> conn = ::wstux::make_intrusive<connection>();
+        conn->start(queue);
+        EXPECT_TRUE(conn->use_count() == 2);
+        EXPECT_TRUE(queue.front() == conn);
+
+        const connection& c_conn = *conn;
+        ::wstux::intrusive_ptr<const connection> c_ptr = c_conn.intrusive_from_this();
+        EXPECT_TRUE(c_ptr == conn);
+        EXPECT_TRUE(conn->use_count() == 3);
+    }
+    EXPECT_TRUE(connection::instance_count == 1);
+    queue.clear();
+    EXPECT_TRUE(connection::instance_count == 0);
+}
+
+TEST(enable_intrusive_from_this, macro)
+{
+    ::wstux::intrusive_ptr<session> ptr(new session);
+    ::wstux::intrusive_ptr<session> self = ptr->intrusive_from_this();
+    EXPECT_TRUE(self == ptr);
+    EXPECT_TRUE(ptr->use_count() == 2);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
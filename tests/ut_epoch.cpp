@@ -0,0 +1,202 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/atomic_intrusive_ptr.h"
+#include "intrusive/epoch.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+/* Makes the global operator new fail, the release must not allocate. */
+bool is_alloc_failed = false;
+
+} // <anonymous> namespace
+
+void* operator new(size_t size)
+{
+    void* p = is_alloc_failed ? NULL : std::malloc(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t /*size*/) noexcept { std::free(p); }
+
+namespace {
+
+class object
+    : public ::wstux::intrusive_ref_counter<object,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::epoch_destroy_policy<>>
+    , public ::wstux::epoch_hook
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    explicit object(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~object() { --instance_count; }
+
+    size_t value;
+};
+
+std::atomic<size_t> object::instance_count(0);
+
+typedef ::wstux::intrusive_ptr<object> object_ptr;
+
+/* Every call may advance the epoch by one. */
+void collect_all()
+{
+    for (size_t i = 0; i < 4; ++i) {
+        ::wstux::collect_epoch();
+    }
+}
+
+} // <anonymous> namespace
+
+TEST(epoch, retire)
+{
+    object_ptr ptr(new object);
+    ptr.reset();
+    EXPECT_TRUE(object::instance_count == 1);
+
+    collect_all();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(epoch, release_without_memory)
+{
+    static const size_t kCount = 2 * ::wstux::details::epoch_domain::kCollectThreshold;
+
+    std::vector<object_ptr> objects;
+    for (size_t i = 0; i < kCount; ++i) {
+        objects.emplace_back(new object(i));
+    }
+    ::wstux::collect_epoch();
+    is_alloc_failed = true;
+    for (object_ptr& ptr : objects) {
+        ptr.reset();
+    }
+    is_alloc_failed = false;
+
+    collect_all();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(epoch, release_by_new_thread)
+{
+    object_ptr ptr(new object);
+    /* The thread has no record, the object is orphaned. */
+    std::thread([&ptr]() { ptr.reset(); }).join();
+    EXPECT_TRUE(object::instance_count == 1);
+
+    collect_all();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(epoch, guard_delays_destroy)
+{
+    ::wstux::atomic_intrusive_ptr<object> published(object_ptr(new object(1)));
+    std::atomic<bool> is_read(false);
+    std::atomic<bool> is_replaced(false);
+    std::atomic<size_t> value(0);
+
+    std::thread reader([&]() {
+        ::wstux::epoch_guard guard;
+        {
+            ::wstux::epoch_guard nested;
+        }
+        const object* p = published.get();
+        is_read = true;
+        while (! is_replaced) {
+            std::this_thread::yield();
+        }
+        value = p->value;
+    });
+    while (! is_read) {
+        std::this_thread::yield();
+    }
+    published.store(object_ptr(new object(2)));
+    collect_all();
+    /* The reader is still inside of the guard. */
+    EXPECT_TRUE(object::instance_count == 2);
+    is_replaced = true;
+    reader.join();
+    EXPECT_TRUE(value == 1);
+
+    collect_all();
+    EXPECT_TRUE(object::instance_count == 1);
+}
+
+TEST(epoch, concurrent_readers)
+{
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 10000;
+
+    {
+        ::wstux::atomic_intrusive_ptr<object> published(object_ptr(new object(0)));
+        std::atomic<bool> is_bad(false);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&published, &is_bad]() {
+                size_t last = 0;
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    ::wstux::epoch_guard guard;
+                    const object* p = published.get();
+                    if (p->value < last) {
+                        is_bad = true;
+                    }
+                    last = p->value;
+                }
+            });
+        }
+        for (size_t i = 1; i <= kIterationCount; ++i) {
+            published.store(object_ptr(new object(i)));
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        EXPECT_FALSE(is_bad);
+    }
+    collect_all();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
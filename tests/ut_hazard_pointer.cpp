@@ -0,0 +1,248 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/atomic_intrusive_ptr.h"
+#include "intrusive/hazard_pointer.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+/* Makes the global operator new fail, the release must not allocate. */
+bool is_alloc_failed = false;
+
+} // <anonymous> namespace
+
+void* operator new(size_t size)
+{
+    void* p = is_alloc_failed ? NULL : std::malloc(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t /*size*/) noexcept { std::free(p); }
+
+namespace {
+
+class object
+    : public ::wstux::intrusive_ref_counter<object,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::hazard_destroy_policy<>>
+    , public ::wstux::hazard_hook
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    explicit object(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~object() { --instance_count; }
+
+    size_t value;
+};
+
+std::atomic<size_t> object::instance_count(0);
+
+typedef ::wstux::intrusive_ptr<object> object_ptr;
+
+} // <anonymous> namespace
+
+TEST(hazard_pointer, retire)
+{
+    object_ptr ptr = ::wstux::make_intrusive<object>();
+    ptr.reset();
+    EXPECT_TRUE(object::instance_count == 1);
+
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(hazard_pointer, protect_delays_destroy)
+{
+    ::wstux::atomic_intrusive_ptr<object> published(::wstux::make_intrusive<object>(1));
+    {
+        ::wstux::hazard_pointer hp;
+        const object* p = hp.protect(published);
+        EXPECT_TRUE(p->value == 1);
+
+        published.store(::wstux::make_intrusive<object>(2));
+        ::wstux::collect_hazard();
+        EXPECT_TRUE(object::instance_count == 2);
+        EXPECT_TRUE(p->value == 1);
+
+        hp.reset();
+        ::wstux::collect_hazard();
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    published.store(object_ptr());
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(hazard_pointer, promote)
+{
+    ::wstux::atomic_intrusive_ptr<object> published(::wstux::make_intrusive<object>(1));
+    ::wstux::hazard_pointer hp;
+    hp.protect(published);
+    object_ptr ptr = hp.promote(published);
+    ASSERT_TRUE(ptr);
+    EXPECT_TRUE(ptr->value == 1);
+
+    published.store(::wstux::make_intrusive<object>(2));
+    EXPECT_FALSE(hp.promote(published));
+
+    /* The promoted pointer outlives the hazard pointer and the slot. */
+    hp.reset();
+    published.store(object_ptr());
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 1);
+    EXPECT_TRUE(ptr->value == 1);
+    ptr.reset();
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(hazard_pointer, promote_unpublished)
+{
+    ::wstux::atomic_intrusive_ptr<object> published(::wstux::make_intrusive<object>(1));
+    ::wstux::hazard_pointer hp;
+    object* p = hp.protect(published);
+
+    /* The unpublished object is promoted while someone owns it. */
+    object_ptr owner = published.exchange(object_ptr());
+    EXPECT_FALSE(hp.promote(published));
+    object_ptr ptr = hp.promote(p);
+    ASSERT_TRUE(ptr.get() == p);
+    ptr.reset();
+
+    /* The dead object is never resurrected. */
+    owner.reset();
+    EXPECT_TRUE(object::instance_count == 1);
+    EXPECT_FALSE(hp.promote(p));
+
+    hp.reset();
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(hazard_pointer, release_without_memory)
+{
+    static const size_t kCount = 2 * ::wstux::details::hazard_domain::kScanThreshold;
+
+    ::wstux::atomic_intrusive_ptr<object> published(::wstux::make_intrusive<object>(0));
+    std::vector<object_ptr> objects;
+    for (size_t i = 0; i < kCount; ++i) {
+        objects.emplace_back(::wstux::make_intrusive<object>(i));
+    }
+    ::wstux::collect_hazard();
+    {
+        /* More hazards than the snapshot of the thread fits, the scans walk
+         * the slots. */
+        std::vector<std::unique_ptr<::wstux::hazard_pointer>> hps;
+        for (size_t i = 0; i < 10; ++i) {
+            hps.emplace_back(new ::wstux::hazard_pointer());
+            hps.back()->protect(published);
+        }
+        is_alloc_failed = true;
+        for (object_ptr& ptr : objects) {
+            ptr.reset();
+        }
+        published.store(object_ptr());
+        is_alloc_failed = false;
+
+        ::wstux::collect_hazard();
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(hazard_pointer, many_slots)
+{
+    ::wstux::atomic_intrusive_ptr<object> published(::wstux::make_intrusive<object>(1));
+    {
+        std::vector<std::unique_ptr<::wstux::hazard_pointer>> hps;
+        for (size_t i = 0; i < 10; ++i) {
+            hps.emplace_back(new ::wstux::hazard_pointer());
+            EXPECT_TRUE(hps.back()->protect(published)->value == 1);
+        }
+        published.store(object_ptr());
+        ::wstux::collect_hazard();
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(hazard_pointer, concurrent_readers)
+{
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 10000;
+
+    {
+        ::wstux::atomic_intrusive_ptr<object> published(::wstux::make_intrusive<object>(0));
+        std::atomic<bool> is_bad(false);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&published, &is_bad]() {
+                ::wstux::hazard_pointer hp;
+                size_t last = 0;
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    const object* p = hp.protect(published);
+                    if (p->value < last) {
+                        is_bad = true;
+                    }
+                    last = p->value;
+                }
+            });
+        }
+        for (size_t i = 1; i <= kIterationCount; ++i) {
+            published.store(::wstux::make_intrusive<object>(i));
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        EXPECT_FALSE(is_bad);
+    }
+    ::wstux::collect_hazard();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
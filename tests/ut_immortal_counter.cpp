@@ -0,0 +1,167 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/immortal_counter.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+class config : public ::wstux::intrusive_ref_counter<config, ::wstux::immortal_counter_policy<size_t>>
+{
+public:
+    static size_t instance_count;
+
+    config() { ++instance_count; }
+    ~config() { --instance_count; }
+
+    size_t value = 1;
+};
+
+size_t config::instance_count = 0;
+
+class macro_config
+{
+    INIT_INTRUSIVE_PTR_WITH_POLICY(::wstux::immortal_counter_policy<uint32_t>);
+
+public:
+    uint32_t use_count() const { return m_ref_counter; }
+};
+
+const ::wstux::intrusive_ptr<config>& default_config()
+{
+    static const ::wstux::intrusive_ptr<config> ptr = ::wstux::make_immortal_intrusive<config>();
+    return ptr;
+}
+
+config* make_singleton()
+{
+    config* p_config = new config();
+    ::wstux::make_immortal(p_config);
+    return p_config;
+}
+
+} // <anonymous> namespace
+
+TEST(immortal_counter, mortal)
+{
+    {
+        ::wstux::intrusive_ptr<config> ptr_1 = ::wstux::make_intrusive<config>();
+        ::wstux::intrusive_ptr<config> ptr_2(ptr_1);
+        EXPECT_TRUE(ptr_1->use_count() == 2);
+    }
+    EXPECT_TRUE(config::instance_count == 0);
+}
+
+TEST(immortal_counter, singleton)
+{
+    static config* const p_default_config = make_singleton();
+    {
+        ::wstux::intrusive_ptr<config> ptr_1(p_default_config);
+        ::wstux::intrusive_ptr<config> ptr_2(ptr_1);
+        EXPECT_TRUE(ptr_1->use_count() == 0);
+    }
+    EXPECT_TRUE(config::instance_count == 1);
+    delete p_default_config;
+}
+
+TEST(immortal_counter, make_immortal_owned)
+{
+    config* p_config = NULL;
+    {
+        ::wstux::intrusive_ptr<config> ptr = ::wstux::make_intrusive<config>();
+        ::wstux::intrusive_ptr<config> copy(ptr);
+        ::wstux::make_immortal(ptr);
+        p_config = ptr.get();
+    }
+    /* The references taken before are released without the destruction. */
+    EXPECT_TRUE(config::instance_count == 1);
+    EXPECT_TRUE(p_config->use_count() == 2);
+    delete p_config;
+}
+
+TEST(immortal_counter, macro)
+{
+    ::wstux::intrusive_ptr<macro_config> ptr(new macro_config);
+    ::wstux::make_immortal(ptr);
+    macro_config* p_config = ptr.get();
+    ptr.reset();
+    ptr.reset(p_config);
+    EXPECT_TRUE(ptr->use_count() == 1);
+    ptr.reset();
+    delete p_config;
+}
+
+TEST(immortal_counter, concurrent_copy)
+{
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 100000;
+
+    config* p_shared_config = make_singleton();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([p_shared_config]() {
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                ::wstux::intrusive_ptr<config> ptr(p_shared_config);
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    EXPECT_TRUE(p_shared_config->use_count() == 0);
+    delete p_shared_config;
+}
+
+TEST(immortal_counter, concurrent_singleton)
+{
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 100000;
+
+    const size_t instance_count = config::instance_count;
+    /* The first copy races the initialization of the singleton. */
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([]() {
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                ::wstux::intrusive_ptr<config> ptr(default_config());
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    EXPECT_TRUE(default_config()->use_count() == 1);
+    EXPECT_TRUE(config::instance_count == instance_count + 1);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,362 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/biased_counter.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/sharded_counter.h"
+#include "intrusive/weak_counter.h"
+
+namespace {
+
+template<typename TPolicy>
+class policy_object : public ::wstux::intrusive_ref_counter<policy_object<TPolicy>, TPolicy>
+{
+public:
+    static size_t instance_count;
+
+    policy_object() { ++instance_count; }
+    policy_object(const policy_object& rhs)
+        : ::wstux::intrusive_ref_counter<policy_object<TPolicy>, TPolicy>(rhs)
+    { ++instance_count; }
+    policy_object& operator=(const policy_object&) = default;
+    ~policy_object() { --instance_count; }
+};
+
+template<typename TPolicy>
+size_t policy_object<TPolicy>::instance_count = 0;
+
+class macro_object
+{
+    INIT_INTRUSIVE_PTR_WITH_POLICY(::wstux::atomic_counter_policy<uint16_t,
+                                                                  std::memory_order_relaxed,
+                                                                  std::memory_order_acq_rel>);
+
+public:
+    uint16_t use_count() const { return m_ref_counter; }
+};
+
+template<typename T>
+class counter_fixture : public ::testing::Test
+{
+public:
+    virtual void SetUp() override {}
+    virtual void TearDown() override {}
+};
+
+using types = testing::Types<::wstux::plain_counter_policy<uint8_t>,
+                             ::wstux::plain_counter_policy<size_t>,
+                             ::wstux::atomic_counter_policy<uint32_t>,
+                             ::wstux::relaxed_atomic_counter_policy<uint32_t>,
+                             ::wstux::acq_rel_atomic_counter_policy<size_t>,
+                             ::wstux::biased_counter_policy<uint32_t>,
+                             ::wstux::weak_counter_policy>;
+TYPED_TEST_SUITE(counter_fixture, types);
+
+} // <anonymous> namespace
+
+TYPED_TEST(counter_fixture, add_ref_release)
+{
+    using object = policy_object<TypeParam>;
+
+    EXPECT_TRUE(object::instance_count == 0);
+    {
+        ::wstux::intrusive_ptr<object> ptr_1(new object);
+        EXPECT_TRUE(ptr_1->use_count() == 1);
+        {
+            ::wstux::intrusive_ptr<object> ptr_2(ptr_1);
+            EXPECT_TRUE(ptr_1->use_count() == 2);
+        }
+        EXPECT_TRUE(ptr_1->use_count() == 1);
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TYPED_TEST(counter_fixture, const_pointer)
+{
+    using object = policy_object<TypeParam>;
+
+    {
+        ::wstux::intrusive_ptr<const object> ptr_1(new object);
+        ::wstux::intrusive_ptr<const object> ptr_2(ptr_1);
+        EXPECT_TRUE(ptr_1->use_count() == 2);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TYPED_TEST(counter_fixture, copy_object)
+{
+    using object = policy_object<TypeParam>;
+
+    {
+        ::wstux::intrusive_ptr<object> ptr_1(new object);
+        ::wstux::intrusive_ptr<object> ptr_2(ptr_1);
+        ::wstux::intrusive_ptr<object> ptr_3(new object(*ptr_1));
+        EXPECT_TRUE(ptr_1->use_count() == 2);
+        EXPECT_TRUE(ptr_3->use_count() == 1);
+
+        *ptr_3 = *ptr_1;
+        EXPECT_TRUE(ptr_1->use_count() == 2);
+        EXPECT_TRUE(ptr_3->use_count() == 1);
+        EXPECT_TRUE(object::instance_count == 2);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TYPED_TEST(counter_fixture, batched_add_ref_release)
+{
+    using object = policy_object<TypeParam>;
+
+    {
+        ::wstux::intrusive_ptr<object> ptr(new object);
+        ::wstux::details::add_ref_n(ptr.get(), 5);
+        EXPECT_TRUE(ptr->use_count() == 6);
+        ::wstux::details::release_n(ptr.get(), 3);
+        EXPECT_TRUE(ptr->use_count() == 3);
+
+        object* p = ptr.detach();
+        ::wstux::details::release_n(p, 2);
+        EXPECT_TRUE(object::instance_count == 1);
+        ::wstux::details::release_n(p, 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(counter, counter_width)
+{
+    EXPECT_TRUE(sizeof(::wstux::basic_ref_counter<::wstux::plain_counter_policy<uint8_t>>) == 1);
+    EXPECT_TRUE(sizeof(::wstux::basic_ref_counter<::wstux::plain_counter_policy<uint32_t>>) == 4);
+    EXPECT_TRUE(sizeof(::wstux::basic_ref_counter<::wstux::relaxed_atomic_counter_policy<uint16_t>>) == 2);
+}
+
+TEST(counter, macro_with_policy)
+{
+    ::wstux::intrusive_ptr<macro_object> ptr_1(new macro_object);
+    ::wstux::intrusive_ptr<macro_object> ptr_2(ptr_1);
+    EXPECT_TRUE(ptr_1->use_count() == 2);
+    ptr_2.reset();
+    EXPECT_TRUE(ptr_1->use_count() == 1);
+
+    ::wstux::details::add_ref_n(ptr_1.get(), 10);
+    EXPECT_TRUE(ptr_1->use_count() == 11);
+    ::wstux::details::release_n(ptr_1.get(), 10);
+    EXPECT_TRUE(ptr_1->use_count() == 1);
+}
+
+TEST(counter, try_add_ref)
+{
+    using object = policy_object<::wstux::atomic_counter_policy<uint32_t>>;
+    using weak_object = policy_object<::wstux::weak_counter_policy>;
+
+    {
+        /* The counter of the object that is not owned yet is zero. */
+        std::unique_ptr<object> p_obj(new object);
+        EXPECT_FALSE(::wstux::intrusive_ptr<object>::try_acquire(p_obj.get()));
+        std::unique_ptr<weak_object> p_weak_obj(new weak_object);
+        EXPECT_FALSE(::wstux::intrusive_ptr<weak_object>::try_acquire(p_weak_obj.get()));
+    }
+    EXPECT_FALSE(::wstux::intrusive_ptr<object>::try_acquire(NULL));
+
+    ::wstux::intrusive_ptr<object> ptr_1(new object);
+    ::wstux::intrusive_ptr<object> ptr_2 = ::wstux::intrusive_ptr<object>::try_acquire(ptr_1.get());
+    ASSERT_TRUE(ptr_2 == ptr_1);
+    EXPECT_TRUE(ptr_1->use_count() == 2);
+
+    ::wstux::intrusive_ptr<macro_object> ptr_3(new macro_object);
+    EXPECT_TRUE(::wstux::intrusive_ptr<macro_object>::try_acquire(ptr_3.get())->use_count() == 2);
+    EXPECT_TRUE(ptr_3->use_count() == 1);
+}
+
+TEST(biased_counter, release_by_other_thread)
+{
+    using object = policy_object<::wstux::biased_counter_policy<size_t>>;
+
+    ::wstux::intrusive_ptr<object> ptr(new object);
+    ::wstux::intrusive_ptr<object> copy(ptr);
+    std::thread t([&copy]() { copy.reset(); });
+    t.join();
+    EXPECT_TRUE(object::instance_count == 1);
+
+    ptr.reset();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(biased_counter, move_to_other_thread)
+{
+    using object = policy_object<::wstux::biased_counter_policy<size_t>>;
+
+    ::wstux::intrusive_ptr<object> ptr(new object);
+    std::thread t([&ptr]() { ::wstux::intrusive_ptr<object> moved(std::move(ptr)); });
+    t.join();
+    /* The last reference is held by the merge request. */
+    EXPECT_TRUE(object::instance_count == 1);
+
+    ::wstux::merge_biased_counters();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(biased_counter, owner_exit)
+{
+    using object = policy_object<::wstux::biased_counter_policy<size_t>>;
+
+    ::wstux::intrusive_ptr<object> ptr;
+    std::thread t([&ptr]() {
+        ::wstux::intrusive_ptr<object> copy(new object);
+        ptr = copy;
+    });
+    t.join();
+    object* p_object = ptr.get();
+    ASSERT_TRUE(p_object != NULL);
+    EXPECT_TRUE(p_object->use_count() == 1);
+    {
+        ::wstux::intrusive_ptr<object> copy(ptr);
+        EXPECT_TRUE(p_object->use_count() == 2);
+    }
+    ptr.reset();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(biased_counter, concurrent_copy)
+{
+    using object = policy_object<::wstux::biased_counter_policy<size_t>>;
+
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 10000;
+
+    ::wstux::intrusive_ptr<object> ptr(new object);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([ptr]() {
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                ::wstux::intrusive_ptr<object> copy(ptr);
+            }
+        });
+    }
+    for (size_t i = 0; i < kIterationCount; ++i) {
+        ::wstux::intrusive_ptr<object> copy(ptr);
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    ::wstux::merge_biased_counters();
+    EXPECT_TRUE(ptr->use_count() == 1);
+
+    ptr.reset();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(biased_counter, release_during_owner_merge)
+{
+    using object = policy_object<::wstux::biased_counter_policy<size_t>>;
+
+    static const size_t kThreadCount = 4;
+    static const size_t kRoundCount = 1000;
+
+    for (size_t r = 0; r < kRoundCount; ++r) {
+        std::vector<::wstux::intrusive_ptr<object>> copies(kThreadCount);
+        std::atomic<bool> is_started(false);
+        std::vector<std::thread> threads;
+        /* The owner merges its counter and exits while the others release the
+         * references taken by it. */
+        std::thread owner([&copies, &is_started]() {
+            ::wstux::intrusive_ptr<object> ptr(new object);
+            for (::wstux::intrusive_ptr<object>& copy : copies) {
+                copy = ptr;
+            }
+            is_started = true;
+            ptr.reset();
+            ::wstux::merge_biased_counters();
+        });
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&copies, &is_started, t]() {
+                while (! is_started) {
+                    std::this_thread::yield();
+                }
+                copies[t].reset();
+            });
+        }
+        owner.join();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(sharded_counter, retire)
+{
+    using object = policy_object<::wstux::sharded_counter_policy<size_t, 4>>;
+
+    ::wstux::intrusive_ptr<object> ptr(new object);
+    ::wstux::intrusive_ptr<object> copy(ptr);
+    EXPECT_TRUE(ptr->use_count() == 2);
+    copy.reset();
+    EXPECT_TRUE(ptr->use_count() == 1);
+
+    copy = ptr;
+    ::wstux::retire(ptr);
+    EXPECT_TRUE(ptr.get() == NULL);
+    EXPECT_TRUE(copy->use_count() == 1);
+    EXPECT_TRUE(object::instance_count == 1);
+
+    copy.reset();
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(sharded_counter, retire_concurrent)
+{
+    using object = policy_object<::wstux::sharded_counter_policy<uint32_t, 2>>;
+
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 10000;
+
+    ::wstux::intrusive_ptr<object> ptr(new object);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([ptr]() {
+            for (size_t i = 0; i < kIterationCount; ++i) {
+                ::wstux::intrusive_ptr<object> copy(ptr);
+            }
+        });
+    }
+    ::wstux::retire(ptr);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
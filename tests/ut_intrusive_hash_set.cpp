@@ -0,0 +1,167 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_hash_set.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+class connection
+    : public ::wstux::intrusive_ref_counter<connection>
+    , public ::wstux::set_hook<>
+{
+public:
+    static size_t instance_count;
+
+    explicit connection(uint64_t k)
+        : key(k)
+    { ++instance_count; }
+    ~connection() { --instance_count; }
+
+    uint64_t key;
+};
+
+size_t connection::instance_count = 0;
+
+/* Sessions are found by name. */
+class session
+    : public ::wstux::intrusive_ref_counter<session>
+    , public ::wstux::set_hook<>
+{
+public:
+    explicit session(const std::string& n)
+        : name(n)
+    {}
+
+    std::string name;
+};
+
+struct session_name
+{
+    const std::string& operator()(const session& s) const { return s.name; }
+};
+
+/* Puts all keys into the same bucket. */
+struct bad_hash
+{
+    size_t operator()(uint64_t) const { return 0; }
+};
+
+typedef ::wstux::intrusive_ptr<connection> connection_ptr;
+typedef ::wstux::intrusive_hash_set<connection, uint64_t> connection_table;
+
+} // <anonymous> namespace
+
+TEST(intrusive_hash_set, insert_find_erase)
+{
+    {
+        connection_table table(10);
+        EXPECT_TRUE(table.bucket_count() == 16);
+        EXPECT_TRUE(table.empty());
+
+        for (uint64_t k = 0; k < 100; ++k) {
+            EXPECT_TRUE(table.insert(connection_ptr(new connection(k))));
+        }
+        EXPECT_TRUE(table.size() == 100);
+        EXPECT_FALSE(table.insert(connection_ptr(new connection(5))));
+        EXPECT_TRUE(connection::instance_count == 100);
+
+        connection* p = table.find(42);
+        EXPECT_TRUE(p != NULL && p->key == 42);
+        EXPECT_TRUE(p->use_count() == 1);
+        EXPECT_FALSE(table.contains(100));
+
+        connection_ptr removed = table.erase(42);
+        EXPECT_TRUE(removed.get() == p);
+        EXPECT_TRUE(removed->use_count() == 1);
+        EXPECT_FALSE(table.erase(42));
+        EXPECT_TRUE(table.size() == 99);
+
+        /* The removed object may be inserted again. */
+        EXPECT_TRUE(table.insert(removed));
+        EXPECT_TRUE(removed->use_count() == 2);
+    }
+    EXPECT_TRUE(connection::instance_count == 0);
+}
+
+TEST(intrusive_hash_set, rehash)
+{
+    {
+        connection_table table(4);
+        for (uint64_t k = 0; k < 64; ++k) {
+            table.insert(connection_ptr(new connection(k)));
+        }
+        EXPECT_TRUE(table.load_factor() == 16.0f);
+        table.rehash(64);
+        EXPECT_TRUE(table.bucket_count() == 64);
+        EXPECT_TRUE(table.size() == 64);
+
+        uint64_t sum = 0;
+        table.for_each([&sum](const connection& conn) { sum += conn.key; });
+        EXPECT_TRUE(sum == 64 * 63 / 2);
+        for (uint64_t k = 0; k < 64; ++k) {
+            EXPECT_TRUE(table.contains(k));
+        }
+        table.clear();
+        EXPECT_TRUE(table.empty());
+        EXPECT_TRUE(connection::instance_count == 0);
+    }
+}
+
+TEST(intrusive_hash_set, collisions)
+{
+    {
+        ::wstux::intrusive_hash_set<connection, uint64_t, ::wstux::member_key, bad_hash> table(8);
+        for (uint64_t k = 0; k < 8; ++k) {
+            table.insert(connection_ptr(new connection(k)));
+        }
+        EXPECT_TRUE(table.erase(0));
+        EXPECT_TRUE(table.erase(7));
+        EXPECT_TRUE(table.erase(3));
+        EXPECT_TRUE(table.size() == 5);
+        EXPECT_TRUE(table.find(4)->key == 4);
+    }
+    EXPECT_TRUE(connection::instance_count == 0);
+}
+
+TEST(intrusive_hash_set, key_of)
+{
+    ::wstux::intrusive_hash_set<session, std::string, session_name> sessions;
+    sessions.insert(::wstux::make_intrusive<session>("alice"));
+    sessions.insert(::wstux::make_intrusive<session>("bob"));
+    EXPECT_TRUE(sessions.find("bob")->name == "bob");
+    EXPECT_FALSE(sessions.contains("carol"));
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
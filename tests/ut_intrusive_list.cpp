@@ -0,0 +1,152 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_list.h"
+#include "intrusive/intrusive_ptr.h"
+
+namespace {
+
+struct lru_tag;
+
+class connection
+    : public ::wstux::intrusive_ref_counter<connection>
+    , public ::wstux::list_hook<>
+    , public ::wstux::list_hook<lru_tag>
+{
+public:
+    static size_t instance_count;
+
+    explicit connection(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~connection() { --instance_count; }
+
+    size_t value;
+};
+
+size_t connection::instance_count = 0;
+
+typedef ::wstux::intrusive_ptr<connection> connection_ptr;
+typedef ::wstux::intrusive_list<connection> connection_list;
+
+std::vector<size_t> values(const connection_list& list)
+{
+    std::vector<size_t> result;
+    for (const connection& conn : list) {
+        result.push_back(conn.value);
+    }
+    return result;
+}
+
+} // <anonymous> namespace
+
+TEST(intrusive_list, push_pop)
+{
+    {
+        connection_list list;
+        EXPECT_TRUE(list.empty());
+        EXPECT_FALSE(list.pop_front());
+
+        connection_ptr ptr(new connection(2));
+        list.push_back(ptr);
+        EXPECT_TRUE(ptr->use_count() == 2);
+        EXPECT_TRUE(static_cast<::wstux::list_hook<>&>(*ptr).is_linked());
+        list.push_front(connection_ptr(new connection(1)));
+        list.push_back(connection_ptr(new connection(3)));
+        EXPECT_TRUE(list.size() == 3);
+        EXPECT_TRUE((values(list) == std::vector<size_t>{1, 2, 3}));
+        EXPECT_TRUE(list.front()->value == 1);
+        EXPECT_TRUE(list.back()->value == 3);
+
+        connection_ptr last = list.pop_back();
+        EXPECT_TRUE(last->value == 3);
+        EXPECT_TRUE(last->use_count() == 1);
+
+        connection_ptr removed = list.erase(ptr.get());
+        EXPECT_TRUE(removed == ptr);
+        EXPECT_FALSE(static_cast<::wstux::list_hook<>&>(*ptr).is_linked());
+        EXPECT_TRUE(list.size() == 1);
+    }
+    EXPECT_TRUE(connection::instance_count == 0);
+}
+
+TEST(intrusive_list, iterators)
+{
+    {
+        connection_list list;
+        for (size_t i = 0; i < 5; ++i) {
+            list.push_back(connection_ptr(new connection(i)));
+        }
+        connection_list::iterator it = list.begin();
+        ++it;
+        it = list.insert(it, connection_ptr(new connection(10)));
+        EXPECT_TRUE(it->value == 10);
+        EXPECT_TRUE((values(list) == std::vector<size_t>{0, 10, 1, 2, 3, 4}));
+
+        for (it = list.begin(); it != list.end();) {
+            it = (it->value % 2 == 0) ? list.erase(it) : std::next(it);
+        }
+        EXPECT_TRUE((values(list) == std::vector<size_t>{1, 3}));
+        EXPECT_TRUE((--list.end())->value == 3);
+        EXPECT_TRUE(connection::instance_count == 2);
+    }
+    EXPECT_TRUE(connection::instance_count == 0);
+}
+
+TEST(intrusive_list, lru)
+{
+    {
+        connection_list all;
+        ::wstux::intrusive_list<connection, lru_tag> lru;
+        for (size_t i = 0; i < 4; ++i) {
+            connection_ptr ptr(new connection(i));
+            all.push_back(ptr);
+            lru.push_front(std::move(ptr));
+        }
+        /* The list of all connections keeps its order. */
+        connection* p_used = &*::wstux::intrusive_list<connection>::iterator_to(all.front());
+        lru.move_to_front(p_used);
+        EXPECT_TRUE(lru.front() == p_used);
+        EXPECT_TRUE(p_used->use_count() == 2);
+        EXPECT_TRUE((values(all) == std::vector<size_t>{0, 1, 2, 3}));
+
+        connection_ptr victim = lru.pop_back();
+        EXPECT_TRUE(victim->value == 1);
+        all.erase(victim.get());
+        victim.reset();
+        EXPECT_TRUE(connection::instance_count == 3);
+    }
+    EXPECT_TRUE(connection::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -95,6 +95,31 @@ struct atomic_counter
     using child = base_atomic_counter;
 };
 
+/* Class with its own hooks and without the destroy policy. */
+struct custom_counter
+{
+    static size_t instance_count;
+
+    explicit custom_counter(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~custom_counter() { --instance_count; }
+
+    mutable size_t ref_count = 0;
+    size_t value;
+};
+
+size_t custom_counter::instance_count = 0;
+
+void intrusive_ptr_add_ref(const custom_counter* p) { ++p->ref_count; }
+
+void intrusive_ptr_release(const custom_counter* p)
+{
+    if (--p->ref_count == 0) {
+        delete p;
+    }
+}
+
 using types = testing::Types<counter, atomic_counter>;
 TYPED_TEST_SUITE(intrusive_fixture, types);
 
@@ -149,6 +174,44 @@ TYPED_TEST(intrusive_fixture, constructor_pointer_in_place)
     EXPECT_TRUE(base::instance_count == 0);
 }
 
+TYPED_TEST(intrusive_fixture, constructor_pointer_adopt)
+{
+    using base = typename TypeParam::base;
+
+    base* p_base = NULL;
+    {
+        ::wstux::intrusive_ptr<base> ptr(new base);
+        p_base = ptr.detach();
+        EXPECT_TRUE(ptr.get() == NULL);
+        EXPECT_TRUE(p_base->use_count() == 1);
+        EXPECT_TRUE(base::instance_count == 1);
+    }
+    EXPECT_TRUE(base::instance_count == 1);
+    {
+        ::wstux::intrusive_ptr<base> ptr(p_base, false);
+        EXPECT_TRUE(ptr.get() == p_base);
+        EXPECT_TRUE(p_base->use_count() == 1);
+    }
+    EXPECT_TRUE(base::instance_count == 0);
+}
+
+TYPED_TEST(intrusive_fixture, reset_adopt)
+{
+    using base = typename TypeParam::base;
+
+    ::wstux::intrusive_ptr<base> ptr_1(new base);
+    ::wstux::intrusive_ptr<base> ptr_2(new base);
+    EXPECT_TRUE(base::instance_count == 2);
+
+    ptr_1.reset(ptr_2.detach(), false);
+    EXPECT_TRUE(ptr_1->use_count() == 1);
+    EXPECT_TRUE(ptr_2.get() == NULL);
+    EXPECT_TRUE(base::instance_count == 1);
+
+    ptr_1.reset();
+    EXPECT_TRUE(base::instance_count == 0);
+}
+
 TYPED_TEST(intrusive_fixture, constructor_copy)
 {
     using base = typename TypeParam::base;
@@ -536,7 +599,22 @@ TYPED_TEST(intrusive_fixture, operator_comparison_3)
     EXPECT_TRUE(! ptr_1);
 }
 
+TEST(intrusive_ptr, make_intrusive_custom_hooks)
+{
+    {
+        ::wstux::intrusive_ptr<custom_counter> ptr = ::wstux::make_intrusive<custom_counter>(42);
+        ::wstux::intrusive_ptr<const custom_counter> ptr_const = ::wstux::make_intrusive<const custom_counter>();
+        EXPECT_TRUE(ptr->value == 42);
+        EXPECT_TRUE(ptr->ref_count == 1);
+        EXPECT_TRUE(custom_counter::instance_count == 2);
+    }
+    EXPECT_TRUE(custom_counter::instance_count == 0);
+}
+
 int main(int /*argc*/, char** /*argv*/)
 {
+    /* The first call of mem_usage() allocates the stdio buffers and would be
+     * reported as a leak by the first test. */
+    ::testing::utils::mem_usage();
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,337 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/epoch.h"
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/intrusive_queue.h"
+#include "intrusive/slab_pool.h"
+
+namespace {
+
+struct stack_tag;
+
+class message
+    : public ::wstux::intrusive_ref_counter<message>
+    , public ::wstux::queue_hook<>
+    , public ::wstux::queue_hook<stack_tag>
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    explicit message(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~message() { --instance_count; }
+
+    size_t value;
+};
+
+std::atomic<size_t> message::instance_count(0);
+
+typedef ::wstux::intrusive_ptr<message> message_ptr;
+
+/* The popped objects are released, the memory stays readable by the policy. */
+template<typename TDestroyPolicy>
+class released_message
+    : public ::wstux::intrusive_ref_counter<released_message<TDestroyPolicy>,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           TDestroyPolicy>
+    , public ::wstux::queue_hook<>
+    , public ::wstux::epoch_hook
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    released_message() { ++instance_count; }
+    ~released_message() { --instance_count; }
+};
+
+template<typename TDestroyPolicy>
+std::atomic<size_t> released_message<TDestroyPolicy>::instance_count(0);
+
+static const size_t kThreadCount = 4;
+static const size_t kIterationCount = 10000;
+
+} // <anonymous> namespace
+
+TEST(intrusive_queue, mpsc_order)
+{
+    {
+        ::wstux::mpsc_queue<message> queue;
+        EXPECT_TRUE(queue.empty());
+        EXPECT_FALSE(queue.pop());
+
+        message_ptr first(new message(1));
+        message* p_first = first.get();
+        queue.push(std::move(first));
+        EXPECT_FALSE(first);
+        /* The reference is moved, not copied. */
+        EXPECT_TRUE(p_first->use_count() == 1);
+        queue.push(message_ptr(new message(2)));
+        queue.push(message_ptr(new message(3)));
+        EXPECT_FALSE(queue.empty());
+
+        message_ptr ptr = queue.pop();
+        EXPECT_TRUE(ptr.get() == p_first);
+        EXPECT_TRUE(ptr->use_count() == 1);
+        EXPECT_TRUE(queue.pop()->value == 2);
+        EXPECT_TRUE(queue.pop()->value == 3);
+        EXPECT_FALSE(queue.pop());
+
+        /* The popped object may be pushed again. */
+        queue.push(std::move(ptr));
+        queue.push(message_ptr(new message(4)));
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+TEST(intrusive_queue, mpsc_concurrent)
+{
+    {
+        ::wstux::mpsc_queue<message> queue;
+        std::vector<std::thread> producers;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            producers.emplace_back([&queue, t]() {
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    queue.push(message_ptr(new message(t * kIterationCount + i)));
+                }
+            });
+        }
+        std::vector<size_t> last(kThreadCount, 0);
+        bool is_ordered = true;
+        for (size_t count = 0; count < kThreadCount * kIterationCount;) {
+            message_ptr ptr = queue.pop();
+            if (! ptr) {
+                std::this_thread::yield();
+                continue;
+            }
+            const size_t t = ptr->value / kIterationCount;
+            const size_t i = ptr->value % kIterationCount + 1;
+            is_ordered = is_ordered && (last[t] < i);
+            last[t] = i;
+            ++count;
+        }
+        for (std::thread& t : producers) {
+            t.join();
+        }
+        EXPECT_TRUE(is_ordered);
+        EXPECT_TRUE(queue.empty());
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+TEST(intrusive_queue, mpmc_ring)
+{
+    {
+        ::wstux::mpmc_ring<message> ring(3);
+        EXPECT_TRUE(ring.capacity() == 4);
+        for (size_t i = 0; i < 4; ++i) {
+            EXPECT_TRUE(ring.try_push(message_ptr(new message(i))));
+        }
+        message_ptr extra(new message(4));
+        EXPECT_FALSE(ring.try_push(std::move(extra)));
+        /* The pointer is kept if the ring is full. */
+        EXPECT_TRUE(extra);
+
+        message_ptr ptr;
+        EXPECT_TRUE(ring.try_pop(ptr));
+        EXPECT_TRUE(ptr->value == 0);
+        EXPECT_TRUE(ptr->use_count() == 1);
+        EXPECT_TRUE(ring.try_push(std::move(extra)));
+        EXPECT_FALSE(extra);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+TEST(intrusive_queue, mpmc_concurrent)
+{
+    {
+        ::wstux::mpmc_ring<message> ring(64);
+        std::atomic<size_t> sum(0);
+        std::atomic<size_t> popped(0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&ring]() {
+                for (size_t i = 1; i <= kIterationCount; ++i) {
+                    message_ptr ptr(new message(i));
+                    while (! ring.try_push(std::move(ptr))) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+            threads.emplace_back([&ring, &sum, &popped]() {
+                message_ptr ptr;
+                while (popped < kThreadCount * kIterationCount) {
+                    if (ring.try_pop(ptr)) {
+                        sum += ptr->value;
+                        ++popped;
+                        ptr.reset();
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        EXPECT_TRUE(sum == kThreadCount * kIterationCount * (kIterationCount + 1) / 2);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+TEST(intrusive_queue, treiber_stack)
+{
+    {
+        ::wstux::treiber_stack<message, stack_tag> stack;
+        ::wstux::mpsc_queue<message> queue;
+        EXPECT_TRUE(stack.empty());
+        EXPECT_FALSE(stack.pop());
+
+        message_ptr ptr(new message(1));
+        /* The object is in the queue and in the stack through different hooks. */
+        queue.push(message_ptr(ptr));
+        stack.push(std::move(ptr));
+        stack.push(message_ptr(new message(2)));
+        EXPECT_TRUE(stack.pop()->value == 2);
+        ptr = stack.pop();
+        EXPECT_TRUE(ptr->value == 1);
+        EXPECT_TRUE(ptr->use_count() == 2);
+        EXPECT_TRUE(stack.empty());
+        EXPECT_TRUE(queue.pop() == ptr);
+
+        stack.push(std::move(ptr));
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+namespace {
+
+template<typename T>
+void churn_stack()
+{
+    static const size_t kObjectCount = 64;
+
+    typedef ::wstux::intrusive_ptr<T> ptr_type;
+    {
+        ::wstux::treiber_stack<T> stack;
+        for (size_t i = 0; i < kObjectCount; ++i) {
+            stack.push(::wstux::make_intrusive<T>());
+        }
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&stack]() {
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    ptr_type ptr = stack.pop();
+                    if (! ptr) {
+                        continue;
+                    }
+                    /* Every other object is released and replaced. */
+                    if (i % 2 == 0) {
+                        ptr = ::wstux::make_intrusive<T>();
+                    }
+                    stack.push(std::move(ptr));
+                }
+                ::wstux::collect_epoch();
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        size_t count = 0;
+        while (stack.pop()) {
+            ++count;
+        }
+        EXPECT_TRUE(count == kObjectCount);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        ::wstux::collect_epoch();
+    }
+    EXPECT_TRUE(T::instance_count == 0);
+}
+
+} // <anonymous> namespace
+
+TEST(intrusive_queue, treiber_epoch_released)
+{
+    churn_stack<released_message<::wstux::epoch_destroy_policy<>>>();
+}
+
+TEST(intrusive_queue, treiber_slab_released)
+{
+    churn_stack<released_message<::wstux::slab_destroy_policy>>();
+}
+
+TEST(intrusive_queue, treiber_concurrent)
+{
+    static const size_t kObjectCount = 64;
+
+    {
+        /* The objects are kept alive, so pop() may read the link of the top
+         * popped by another thread. */
+        std::vector<message_ptr> objects;
+        ::wstux::treiber_stack<message, stack_tag> stack;
+        for (size_t i = 0; i < kObjectCount; ++i) {
+            objects.emplace_back(new message(i));
+            stack.push(message_ptr(objects.back()));
+        }
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&stack]() {
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    message_ptr ptr = stack.pop();
+                    if (ptr) {
+                        ++ptr->value;
+                        stack.push(std::move(ptr));
+                    }
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        size_t count = 0;
+        while (stack.pop()) {
+            ++count;
+        }
+        EXPECT_TRUE(count == kObjectCount);
+        for (const message_ptr& ptr : objects) {
+            EXPECT_TRUE(ptr->use_count() == 1);
+        }
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,191 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/intrusive_range.h"
+
+namespace {
+
+/* Counts the counter operations, a batched one is counted once. */
+struct counting_policy
+{
+    typedef size_t value_type;
+    typedef size_t counter_type;
+
+    static size_t operation_count;
+
+    static value_type load(const counter_type& c) { return c; }
+
+    static void increment(counter_type& c) { ++operation_count; ++c; }
+
+    static void increment(counter_type& c, value_type n) { ++operation_count; c += n; }
+
+    static bool decrement(counter_type& c) { ++operation_count; return (--c == 0); }
+
+    static bool decrement(counter_type& c, value_type n) { ++operation_count; return ((c -= n) == 0); }
+};
+
+size_t counting_policy::operation_count = 0;
+
+class object : public ::wstux::intrusive_ref_counter<object, counting_policy>
+{
+public:
+    static size_t instance_count;
+
+    object() { ++instance_count; }
+    ~object() { --instance_count; }
+};
+
+size_t object::instance_count = 0;
+
+/* Class with the single hooks only. */
+class single_hook_object
+{
+public:
+    size_t use_count() const { return m_counter; }
+
+private:
+    friend void intrusive_ptr_add_ref(single_hook_object* p) { ++p->m_counter; }
+
+    friend void intrusive_ptr_release(single_hook_object* p)
+    {
+        if (--p->m_counter == 0) {
+            delete p;
+        }
+    }
+
+private:
+    size_t m_counter = 0;
+};
+
+typedef ::wstux::intrusive_ptr<object> object_ptr;
+
+/* Handles of three shared objects, grouped by the object. */
+std::vector<object_ptr> make_handles(size_t count_per_object)
+{
+    std::vector<object_ptr> handles;
+    for (size_t i = 0; i < 3; ++i) {
+        object_ptr ptr(new object);
+        handles.insert(handles.end(), count_per_object, ptr);
+    }
+    return handles;
+}
+
+} // <anonymous> namespace
+
+TEST(intrusive_range, uninitialized_copy_n)
+{
+    {
+        std::vector<object_ptr> handles = make_handles(100);
+        EXPECT_TRUE(handles[0]->use_count() == 100);
+
+        alignas(object_ptr) unsigned char storage[300 * sizeof(object_ptr)];
+        object_ptr* p_copy = reinterpret_cast<object_ptr*>(storage);
+        counting_policy::operation_count = 0;
+        object_ptr* p_end = ::wstux::uninitialized_copy_n(handles.data(), handles.size(), p_copy);
+        EXPECT_TRUE(p_end == p_copy + 300);
+        EXPECT_TRUE(counting_policy::operation_count == 3);
+        EXPECT_TRUE(p_copy[0] == handles[0]);
+        EXPECT_TRUE(handles[0]->use_count() == 200);
+        EXPECT_TRUE(handles[299]->use_count() == 200);
+
+        counting_policy::operation_count = 0;
+        ::wstux::destroy_n(p_copy, 300);
+        EXPECT_TRUE(counting_policy::operation_count == 3);
+        EXPECT_TRUE(handles[0]->use_count() == 100);
+
+        counting_policy::operation_count = 0;
+        ::wstux::release_n(handles.data(), handles.size());
+        EXPECT_TRUE(counting_policy::operation_count == 3);
+        EXPECT_TRUE(handles[0].get() == NULL);
+        EXPECT_TRUE(object::instance_count == 0);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(intrusive_range, copy_n)
+{
+    {
+        std::vector<object_ptr> src = make_handles(10);
+        std::vector<object_ptr> dst = make_handles(10);
+        EXPECT_TRUE(object::instance_count == 6);
+
+        counting_policy::operation_count = 0;
+        ::wstux::copy_n(src.data(), src.size(), dst.data());
+        EXPECT_TRUE(counting_policy::operation_count == 6);
+        EXPECT_TRUE(object::instance_count == 3);
+        EXPECT_TRUE(dst[0] == src[0]);
+        EXPECT_TRUE(src[0]->use_count() == 20);
+
+        /* Self assignment. */
+        ::wstux::copy_n(dst.data(), dst.size(), dst.data());
+        EXPECT_TRUE(src[0]->use_count() == 20);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(intrusive_range, copy_n_alias)
+{
+    {
+        /* The object released from 'dst[0]' is assigned to 'dst[1]'. */
+        object_ptr ptr(new object);
+        std::vector<object_ptr> dst(2);
+        dst[0] = ptr;
+        std::vector<object_ptr> src(2);
+        src[1] = ptr;
+        ptr.reset();
+
+        ::wstux::copy_n(src.data(), src.size(), dst.data());
+        EXPECT_TRUE(dst[0].get() == NULL);
+        ASSERT_TRUE(dst[1].get() != NULL);
+        EXPECT_TRUE(dst[1]->use_count() == 2);
+        EXPECT_TRUE(object::instance_count == 1);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+TEST(intrusive_range, single_hooks)
+{
+    ::wstux::intrusive_ptr<single_hook_object> ptr(new single_hook_object);
+    std::vector<::wstux::intrusive_ptr<single_hook_object>> src(10, ptr);
+    std::vector<::wstux::intrusive_ptr<single_hook_object>> dst(10);
+
+    ::wstux::copy_n(src.data(), src.size(), dst.data());
+    EXPECT_TRUE(ptr->use_count() == 21);
+    ::wstux::release_n(dst.data(), dst.size());
+    ::wstux::release_n(src.data(), src.size());
+    EXPECT_TRUE(ptr->use_count() == 1);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
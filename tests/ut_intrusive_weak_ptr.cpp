@@ -0,0 +1,143 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/intrusive_weak_ptr.h"
+#include "intrusive/weak_counter.h"
+
+namespace {
+
+class object : public ::wstux::intrusive_ref_counter<object, ::wstux::weak_counter_policy>
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    object() { ++instance_count; }
+    ~object() { --instance_count; }
+};
+
+std::atomic<size_t> object::instance_count(0);
+
+class macro_object
+{
+    INIT_INTRUSIVE_PTR_WITH_POLICY(::wstux::weak_counter_policy);
+};
+
+typedef ::wstux::intrusive_ptr<object> object_ptr;
+typedef ::wstux::intrusive_weak_ptr<object> object_weak_ptr;
+
+} // <anonymous> namespace
+
+TEST(intrusive_weak_ptr, counter_width)
+{
+    EXPECT_TRUE(sizeof(::wstux::basic_ref_counter<::wstux::weak_counter_policy>) == sizeof(void*));
+}
+
+TEST(intrusive_weak_ptr, lock)
+{
+    object_weak_ptr weak;
+    EXPECT_TRUE(weak.expired());
+    EXPECT_TRUE(weak.lock().get() == NULL);
+    {
+        object_ptr ptr(new object);
+        object_ptr copy(ptr);
+        weak = ptr;
+        EXPECT_FALSE(weak.expired());
+        EXPECT_TRUE(weak.use_count() == 2);
+        EXPECT_TRUE(ptr->use_count() == 2);
+
+        object_ptr locked = weak.lock();
+        EXPECT_TRUE(locked == ptr);
+        EXPECT_TRUE(ptr->use_count() == 3);
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+    EXPECT_TRUE(weak.expired());
+    EXPECT_TRUE(weak.lock().get() == NULL);
+}
+
+TEST(intrusive_weak_ptr, copy_and_move)
+{
+    object_ptr ptr(new object);
+    object_weak_ptr weak_1(ptr);
+    object_weak_ptr weak_2(weak_1);
+    object_weak_ptr weak_3(std::move(weak_1));
+    EXPECT_TRUE(weak_1.expired());
+    EXPECT_TRUE(weak_2.lock() == ptr);
+    EXPECT_TRUE(weak_3.lock() == ptr);
+
+    ptr.reset();
+    EXPECT_TRUE(object::instance_count == 0);
+    EXPECT_TRUE(weak_2.expired());
+    EXPECT_TRUE(weak_3.expired());
+}
+
+TEST(intrusive_weak_ptr, macro_with_policy)
+{
+    ::wstux::intrusive_ptr<macro_object> ptr(new macro_object);
+    ::wstux::intrusive_weak_ptr<macro_object> weak(ptr);
+    EXPECT_TRUE(weak.lock() == ptr);
+    ptr.reset();
+    EXPECT_TRUE(weak.expired());
+}
+
+TEST(intrusive_weak_ptr, concurrent_lock)
+{
+    static const size_t kThreadCount = 4;
+    static const size_t kIterationCount = 10000;
+
+    for (size_t round = 0; round < 10; ++round) {
+        object_ptr ptr(new object);
+        object_weak_ptr weak(ptr);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreadCount; ++t) {
+            threads.emplace_back([&weak]() {
+                object_weak_ptr local(weak);
+                for (size_t i = 0; i < kIterationCount; ++i) {
+                    object_ptr locked = local.lock();
+                    if (! locked) {
+                        break;
+                    }
+                }
+            });
+        }
+        ptr.reset();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        EXPECT_TRUE(weak.expired());
+    }
+    EXPECT_TRUE(object::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,159 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/borrowed_ptr.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/intrusive_weak_ptr.h"
+#include "intrusive/relocate.h"
+
+namespace {
+
+/* Counts the calls of the hooks. */
+class counted
+{
+public:
+    static size_t add_ref_count;
+    static size_t release_count;
+
+    size_t use_count() const { return m_counter; }
+
+private:
+    friend void intrusive_ptr_add_ref(counted* p)
+    {
+        ++add_ref_count;
+        ++p->m_counter;
+    }
+
+    friend void intrusive_ptr_release(counted* p)
+    {
+        ++release_count;
+        if (--p->m_counter == 0) {
+            delete p;
+        }
+    }
+
+private:
+    size_t m_counter = 0;
+};
+
+size_t counted::add_ref_count = 0;
+size_t counted::release_count = 0;
+
+typedef ::wstux::intrusive_ptr<counted> counted_ptr;
+
+static_assert(std::is_nothrow_move_constructible<counted_ptr>::value, "");
+static_assert(std::is_nothrow_move_assignable<counted_ptr>::value, "");
+static_assert(std::is_nothrow_destructible<counted_ptr>::value, "");
+static_assert(noexcept(std::declval<counted_ptr&>().swap(std::declval<counted_ptr&>())), "");
+static_assert(::wstux::is_trivially_relocatable<counted_ptr>::value, "");
+static_assert(::wstux::is_trivially_relocatable<::wstux::borrowed_ptr<counted>>::value, "");
+static_assert(::wstux::is_trivially_relocatable<int>::value, "");
+
+/* Storage for the relocated objects. */
+template<typename T, size_t TSize>
+struct raw_buffer
+{
+    T* data() { return reinterpret_cast<T*>(storage); }
+
+    alignas(T) unsigned char storage[TSize * sizeof(T)];
+};
+
+} // <anonymous> namespace
+
+TEST(relocate, vector_grow)
+{
+    std::vector<counted_ptr> ptrs;
+    for (size_t i = 0; i < 100; ++i) {
+        ptrs.emplace_back(new counted);
+    }
+    /* The reallocations move the pointers instead of copying them. */
+    EXPECT_TRUE(counted::add_ref_count == 100);
+    EXPECT_TRUE(counted::release_count == 0);
+
+    ptrs.clear();
+    EXPECT_TRUE(counted::release_count == 100);
+    counted::add_ref_count = 0;
+    counted::release_count = 0;
+}
+
+TEST(relocate, trivially_relocatable)
+{
+    raw_buffer<counted_ptr, 8> src;
+    raw_buffer<counted_ptr, 8> dst;
+    for (size_t i = 0; i < 4; ++i) {
+        ::new (static_cast<void*>(src.data() + i)) counted_ptr(new counted);
+    }
+    counted* p_first = src.data()[0].get();
+
+    counted_ptr* p_end = ::wstux::relocate(src.data(), src.data() + 4, dst.data());
+    EXPECT_TRUE(p_end == dst.data() + 4);
+    EXPECT_TRUE(dst.data()[0].get() == p_first);
+    EXPECT_TRUE(dst.data()[0]->use_count() == 1);
+    EXPECT_TRUE(counted::add_ref_count == 4);
+    EXPECT_TRUE(counted::release_count == 0);
+
+    /* Overlapping ranges. */
+    ::wstux::relocate(dst.data(), dst.data() + 4, dst.data() + 2);
+    EXPECT_TRUE(dst.data()[2].get() == p_first);
+
+    for (size_t i = 2; i < 6; ++i) {
+        dst.data()[i].~counted_ptr();
+    }
+    EXPECT_TRUE(counted::release_count == 4);
+    counted::add_ref_count = 0;
+    counted::release_count = 0;
+}
+
+TEST(relocate, nothrow_movable)
+{
+    static_assert(! ::wstux::is_trivially_relocatable<std::string>::value, "");
+
+    raw_buffer<std::string, 4> buf;
+    ::new (static_cast<void*>(buf.data())) std::string("first string that is not short");
+    ::new (static_cast<void*>(buf.data() + 1)) std::string("second");
+
+    ::wstux::relocate(buf.data(), buf.data() + 2, buf.data() + 1);
+    EXPECT_TRUE(buf.data()[1] == "first string that is not short");
+    EXPECT_TRUE(buf.data()[2] == "second");
+
+    std::string* p = ::wstux::relocate_at(buf.data() + 2, buf.data());
+    EXPECT_TRUE(*p == "second");
+
+    buf.data()[0].~basic_string();
+    buf.data()[1].~basic_string();
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,142 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <testing/testdefs.h>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/slab_pool.h"
+
+namespace {
+
+class message
+    : public ::wstux::intrusive_ref_counter<message,
+                                           ::wstux::relaxed_atomic_counter_policy<size_t>,
+                                           ::wstux::slab_destroy_policy>
+{
+public:
+    static std::atomic<size_t> instance_count;
+
+    explicit message(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~message() { --instance_count; }
+
+    size_t value;
+};
+
+std::atomic<size_t> message::instance_count(0);
+
+} // <anonymous> namespace
+
+TEST(slab_pool, reuse_local)
+{
+    void* p_1 = ::wstux::slab_allocate(24);
+    void* p_2 = ::wstux::slab_allocate(24);
+    EXPECT_TRUE(p_1 != p_2);
+    EXPECT_TRUE(reinterpret_cast<uintptr_t>(p_1) % 16 == 0);
+
+    ::wstux::slab_deallocate(p_1, 24);
+    void* p_3 = ::wstux::slab_allocate(32);
+    EXPECT_TRUE(p_3 == p_1);
+
+    ::wstux::slab_deallocate(p_2, 24);
+    ::wstux::slab_deallocate(p_3, 32);
+}
+
+TEST(slab_pool, big_and_aligned)
+{
+    void* p_big = ::wstux::slab_allocate(4096);
+    void* p_aligned = ::wstux::slab_allocate(64, 64);
+    EXPECT_TRUE(reinterpret_cast<uintptr_t>(p_aligned) % 64 == 0);
+    ::wstux::slab_deallocate(p_big, 4096);
+    ::wstux::slab_deallocate(p_aligned, 64, 64);
+}
+
+TEST(slab_pool, remote_free)
+{
+    void* p = ::wstux::slab_allocate(100);
+    std::thread t([p]() { ::wstux::slab_deallocate(p, 100); });
+    t.join();
+
+    /* The block is returned to the owner through its remote list. */
+    void* p_again = ::wstux::slab_allocate(100);
+    EXPECT_TRUE(p_again == p);
+    ::wstux::slab_deallocate(p_again, 100);
+}
+
+TEST(slab_pool, orphaned_cache)
+{
+    void* p = NULL;
+    std::thread t([&p]() { p = ::wstux::slab_allocate(200); });
+    t.join();
+
+    std::thread t2([p]() {
+        /* The new thread adopts the cache of the exited one. */
+        ::wstux::slab_deallocate(p, 200);
+        void* p_again = ::wstux::slab_allocate(200);
+        EXPECT_TRUE(p_again == p);
+        ::wstux::slab_deallocate(p_again, 200);
+    });
+    t2.join();
+}
+
+TEST(slab_pool, make_intrusive)
+{
+    {
+        ::wstux::intrusive_ptr<message> ptr = ::wstux::make_intrusive<message>(5);
+        EXPECT_TRUE(ptr->value == 5);
+        EXPECT_TRUE(message::instance_count == 1);
+    }
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+TEST(slab_pool, handoff)
+{
+    static const size_t kCount = 10000;
+
+    std::vector<::wstux::intrusive_ptr<message>> messages;
+    for (size_t i = 0; i < kCount; ++i) {
+        messages.push_back(::wstux::make_intrusive<message>(i));
+    }
+    std::thread t([&messages]() { messages.clear(); });
+    t.join();
+    EXPECT_TRUE(message::instance_count == 0);
+
+    for (size_t i = 0; i < kCount; ++i) {
+        messages.push_back(::wstux::make_intrusive<message>(i));
+    }
+    messages.clear();
+    EXPECT_TRUE(message::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,185 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2023 Chistyakov Alexander.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#ifdef __unix__
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <testing/testdefs.h>
+
+#include "intrusive/intrusive_counter.h"
+#include "intrusive/intrusive_ptr.h"
+#include "intrusive/tagged_intrusive_ptr.h"
+
+namespace {
+
+/* Node of a trie with the color bit on each child link. */
+class node : public ::wstux::intrusive_ref_counter<node>
+{
+public:
+    static size_t instance_count;
+
+    explicit node(size_t v = 0)
+        : value(v)
+    { ++instance_count; }
+    ~node() { --instance_count; }
+
+    size_t value;
+    ::wstux::tagged_intrusive_ptr<node, 1> children[4];
+};
+
+size_t node::instance_count = 0;
+
+typedef ::wstux::tagged_intrusive_ptr<node, 1> link_ptr;
+typedef ::wstux::tagged_intrusive_ptr<node, 2> tagged_ptr;
+
+static_assert(sizeof(link_ptr) == sizeof(node*), "");
+static_assert(std::is_nothrow_move_constructible<link_ptr>::value, "");
+static_assert(::wstux::is_trivially_relocatable<link_ptr>::value, "");
+
+#ifdef __unix__
+/* Runs the function in the child process, returns true if it aborts. */
+template<typename TFunc>
+bool is_aborted(TFunc func)
+{
+    const pid_t pid = ::fork();
+    if (pid == 0) {
+        func();
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return (WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+}
+#endif
+
+} // <anonymous> namespace
+
+TEST(tagged_intrusive_ptr, constructor)
+{
+    {
+        link_ptr empty;
+        EXPECT_FALSE(empty);
+        EXPECT_TRUE(empty.get() == NULL);
+        EXPECT_TRUE(empty.tag() == 0);
+
+        tagged_ptr ptr(new node(7), 3);
+        EXPECT_TRUE(node::instance_count == 1);
+        EXPECT_TRUE(ptr);
+        EXPECT_TRUE(ptr.tag() == 3);
+        EXPECT_TRUE(ptr->value == 7);
+        EXPECT_TRUE(ptr->use_count() == 1);
+
+        tagged_ptr copy(ptr);
+        EXPECT_TRUE(copy == ptr);
+        EXPECT_TRUE(copy.tag() == 3);
+        EXPECT_TRUE(ptr->use_count() == 2);
+
+        tagged_ptr moved(std::move(copy));
+        EXPECT_FALSE(copy);
+        EXPECT_TRUE(moved.get() == ptr.get());
+        EXPECT_TRUE(ptr->use_count() == 2);
+    }
+    EXPECT_TRUE(node::instance_count == 0);
+}
+
+TEST(tagged_intrusive_ptr, tag)
+{
+    {
+        ::wstux::intrusive_ptr<node> owner(new node(1));
+        tagged_ptr ptr(owner, 2);
+        EXPECT_TRUE(owner->use_count() == 2);
+
+        ptr.set_tag(1);
+        EXPECT_TRUE(ptr.tag() == 1);
+        EXPECT_TRUE(ptr.get() == owner.get());
+        EXPECT_TRUE((*ptr).value == 1);
+
+        tagged_ptr other(owner.get(), 2);
+        EXPECT_TRUE(other != ptr);
+        other.set_tag(1);
+        EXPECT_TRUE(other == ptr);
+
+        ::wstux::intrusive_ptr<node> promoted = ptr.promote();
+        EXPECT_TRUE(promoted == owner);
+        EXPECT_TRUE(owner->use_count() == 4);
+
+        node* p = ptr.detach();
+        EXPECT_FALSE(ptr);
+        EXPECT_TRUE(ptr.tag() == 0);
+        ptr.reset(p, 3);
+        EXPECT_TRUE(owner->use_count() == 5);
+        intrusive_ptr_release(p);
+        EXPECT_TRUE(ptr.tag() == 3);
+        EXPECT_TRUE(owner->use_count() == 4);
+
+        ptr.reset();
+        EXPECT_TRUE(owner->use_count() == 3);
+    }
+    EXPECT_TRUE(node::instance_count == 0);
+}
+
+#ifdef __unix__
+TEST(tagged_intrusive_ptr, rejected_tag)
+{
+    {
+        ::wstux::intrusive_ptr<node> owner(new node(1));
+        node* p = owner.get();
+        EXPECT_TRUE(is_aborted([p]() { tagged_ptr ptr(p, 4); }));
+        EXPECT_TRUE(is_aborted([p]() { tagged_ptr ptr(p); ptr.set_tag(tagged_ptr::kTagMask + 1); }));
+        EXPECT_FALSE(is_aborted([p]() { tagged_ptr ptr(p); ptr.set_tag(tagged_ptr::kTagMask); }));
+        EXPECT_TRUE(owner->use_count() == 1);
+    }
+    EXPECT_TRUE(node::instance_count == 0);
+}
+#endif
+
+TEST(tagged_intrusive_ptr, trie)
+{
+    {
+        link_ptr root(new node(0));
+        for (size_t i = 0; i < 4; ++i) {
+            root->children[i] = link_ptr(new node(i + 1), i % 2);
+        }
+        EXPECT_TRUE(node::instance_count == 5);
+
+        link_ptr child = root->children[3];
+        root.reset();
+        EXPECT_TRUE(node::instance_count == 1);
+        EXPECT_TRUE(child->value == 4);
+        EXPECT_TRUE(child.tag() == 1);
+    }
+    EXPECT_TRUE(node::instance_count == 0);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    return RUN_ALL_TESTS();
+}